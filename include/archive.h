@@ -1,10 +1,15 @@
 #include <map>
+#include <set>
 
 #ifndef ARCHIVE_H
 #define ARCHIVE_H
 
-std::map<std::string, std::string> getInfoFromZip(std::string zip_path);
+std::map<std::string, std::string> getInfoFromZip(std::string zip_path, std::map<std::string, std::string> *sizes = nullptr);
+std::map<std::string, std::string> getInfoFrom7z(std::string path, std::map<std::string, std::string> *sizes = nullptr);
+bool readInfoFrom7z(std::string path, std::map<std::string, std::string> &data, std::map<std::string, std::string> *sizes);
+std::map<std::string, std::vector<std::string>> hashArchive(std::string filename, int start_offset = -1, std::vector<std::tuple<int, std::string>> data = {}, int part = 0, int no_of_parts = 1, const std::set<std::string> &names = {});
 void extract(std::string filename, std::string destination);
 void write_zip(std::string destination, std::vector<std::string> filenames, std::string rootfolder, std::string compression_level);
+void write_7z(std::string destination, std::vector<std::string> filenames, std::string rootfolder, std::string compression_level);
 
 #endif
\ No newline at end of file
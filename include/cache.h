@@ -1,4 +1,7 @@
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <string_view>
 
 #ifndef CACHE_H
 #define CACHE_H
@@ -13,6 +16,10 @@
  * md5: vector containing md5 of all entries in cache
  * sha1: vector containing sha1 of all entries in cache
  * status: vector containing status of all entries in cache
+ * set_count: map with key as set name and value as tuple containing roms have, roms total (for that set)
+ * sets_have, sets_total, roms_have, roms_total: totals derived from set_count, kept up to date as entries are added/removed
+ * entry_index: map with key as entryKey() of an entry and value as its index in the vectors above
+ * dead_rows: number of lines in cache that are blank or superseded by a later entry with the same set name and rom name
  */
 struct cacheData {
   std::vector<std::string> info;
@@ -22,14 +29,33 @@ struct cacheData {
   std::vector<std::string> md5;
   std::vector<std::string> sha1;
   std::vector<std::string> status;
+  std::unordered_map<std::string, std::tuple<int, int>> set_count;
+  int sets_have = 0;
+  int sets_total = 0;
+  int roms_have = 0;
+  int roms_total = 0;
+  std::unordered_map<std::string, int> entry_index;
+  int dead_rows = 0;
 };
 
+struct datData; // see dat.h
+
 std::tuple<std::string, std::string> getCachePath(std::string dat_path);
 void createNewCache(std::string dat_path, std::string folder_path);
 bool hasUpdate(std::string dat_path);
-cacheData getDataFromCache(std::string dat_path);
+void updateSetCount(cacheData &cache_data, const std::string &set_name, const std::string &status, int delta);
+bool nextField(const char *&p, const char *end, std::string &scratch, std::string_view &field);
+cacheData getDataFromCache(std::string dat_path, bool verify = true);
+bool needsCompaction(const cacheData &cache_data);
+void writeCache(std::string dat_path, cacheData &cache_data);
+bool verifyCache(std::string dat_path);
 void updateCache(std::string dat_path);
 cacheData addToCache(std::string dat_path, std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> to_add_to_cache);
-std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> getMissing(std::string dat_path, cacheData cache_data);
+std::string entryKey(std::string_view set_name, std::string_view rom_name);
+std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> getMissing(const datData &dat_data, const cacheData &cache_data);
+std::string getZipStatsPath(std::string dat_path);
+std::tuple<std::string, std::string> getFileStat(std::string path);
+std::map<std::string, std::tuple<std::string, std::string, std::string>> getZipStats(std::string dat_path);
+void writeZipStats(std::string dat_path, const std::map<std::string, std::tuple<std::string, std::string, std::string>> &zip_stats);
 
 #endif
\ No newline at end of file
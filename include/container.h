@@ -0,0 +1,33 @@
+#include <map>
+#include <set>
+
+#include <workspace.h>
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+/*
+ * setContainer
+ *
+ * path: path to where the set's files are stored (ends with a forward slash if it is a directory)
+ * type: "zip", "7z", "dir" (an uncompressed folder of files, named as the set) or "file" (a single uncompressed file, named as the set plus its extension)
+ */
+struct setContainer {
+  std::string path;
+  std::string type;
+};
+
+std::map<std::string, setContainer> getSetContainers(std::string folder_path, bool print_ignored = false);
+setContainer getSetContainer(const std::map<std::string, setContainer> &containers, std::string folder_path, std::string set_name);
+std::string getContainerFilePath(const setContainer &container, std::string name);
+std::vector<std::string> getContainerEntryNames(const setContainer &container);
+std::map<std::string, std::string> getContainerInfo(const setContainer &container, std::map<std::string, std::string> *sizes = nullptr);
+std::map<std::string, std::vector<std::string>> hashContainer(const setContainer &container, int start_offset = -1, std::vector<std::tuple<int, std::string>> data = {}, int part = 0, int no_of_parts = 1, const std::set<std::string> &names = {});
+std::tuple<std::string, std::string> getContainerStat(const setContainer &container);
+std::string getContainerListingCRC32(const setContainer &container);
+bool loadContainer(workspace &ws, const setContainer &container);
+bool writeContainer(const setContainer &container, workspace &ws, std::string scratch_dir);
+bool addFilesToContainer(const setContainer &container, std::vector<std::string> filenames, std::string rootfolder, std::string scratch_dir, bool sorted = false);
+void removeContainer(const setContainer &container);
+
+#endif
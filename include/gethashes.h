@@ -1,8 +1,46 @@
 #include <vector>
 
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+
 #ifndef GETHASHES_H
 #define GETHASHES_H
 
+/*
+ * hashState
+ *
+ * size: number of bytes hashed so far (without skipped header)
+ * crc32: CRC32 of bytes hashed so far (without skipped header)
+ * raw_size: number of bytes passed to updateHashes() so far (with header)
+ * raw_crc32: CRC32 of bytes passed to updateHashes() so far (with header)
+ * md5: MD5 context
+ * sha1: SHA1 context
+ * start_offset: offset to start hashing from if header is skipped, -1 if not skipping header (see getHashes())
+ * data: offsets and their expected values that have to match for the header to be skipped (see getHashes())
+ * head: first bytes passed in, held back until it is known whether the header is skipped
+ * head_size: number of bytes needed in head to know whether the header is skipped
+ * head_done: whether head has been hashed
+ */
+struct hashState {
+  unsigned long long size;
+  unsigned int crc32;
+  unsigned long long raw_size;
+  unsigned int raw_crc32;
+  MD5_CTX md5;
+  SHA_CTX sha1;
+  int start_offset;
+  std::vector<std::tuple<int, std::string>> data;
+  std::string head;
+  size_t head_size;
+  bool head_done;
+};
+
+void initHashes(hashState &state, int start_offset = -1, std::vector<std::tuple<int, std::string>> data = {});
+void updateHashes(hashState &state, const char *buf, size_t len);
+std::vector<std::string> finishHashes(hashState &state);
+std::string getRawCRC32(const hashState &state);
+std::string getCRC32(std::string path);
+std::string getSHA1(std::string path);
 std::vector<std::string> getHashes(std::string path, int start_offset = -1, std::vector<std::tuple<int, std::string>> data = {});
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,40 @@
+#include <set>
+
+#ifndef HASHSTORE_H
+#define HASHSTORE_H
+
+/*
+ * hashStore
+ *
+ * Every entry of every DAT that has been added to the store is a row; a row says which content (sha1, crc32, size) that DAT wants for a set/rom, and where it is on disk if we have it
+ *
+ * sha1: vector containing sha1 of all rows ("-" if the DAT has no SHA1 for that rom)
+ * crc32: vector containing crc32 of all rows
+ * size: vector containing size of all rows
+ * dat_path: vector containing path of the DAT each row comes from
+ * set_name: vector containing set names of all rows
+ * rom_name: vector containing rom names of all rows
+ * location: vector containing path of the zip (or 7z, directory or file, see container.h) that has the rom, or "-" if it is missing
+ */
+struct hashStore {
+  std::vector<std::string> sha1;
+  std::vector<std::string> crc32;
+  std::vector<std::string> size;
+  std::vector<std::string> dat_path;
+  std::vector<std::string> set_name;
+  std::vector<std::string> rom_name;
+  std::vector<std::string> location;
+};
+
+struct datData; // see dat.h
+struct cacheData; // see cache.h
+
+std::string getHashStorePath();
+hashStore getHashStore();
+void writeHashStore(hashStore &store);
+void removeFromHashStore(hashStore &store, const std::set<std::string> &dat_paths);
+void addToHashStore(hashStore &store, std::string dat_path, std::string folder_path, const datData &dat_data, const cacheData &cache_data);
+void updateHashStore(hashStore &store, std::string dat_path, std::string folder_path, const datData &dat_data, const cacheData &cache_data);
+void refreshHashStore(const std::vector<std::tuple<std::string, std::string>> &profiles);
+
+#endif
@@ -6,8 +6,12 @@ void genConfig(std::tuple<std::string, std::string> info = std::make_tuple("not_
 void listProfiles();
 std::tuple<std::string, std::string> getPaths(std::string profile_no);
 void showInfo(std::string dat_path, std::string hash = "not_set", std::string show = "not_set");
-void batchScan(std::string dat_group, bool toRebuild = false);
+std::vector<std::tuple<std::string, std::string>> getGroupProfiles(std::string dat_group);
+void batchScan(std::string dat_group, bool toRebuild = false, bool quick = false);
+void rebuildGroup(std::string dat_group, bool toRemove, bool sorted = false);
 void deleteProfile(std::string dat_path, bool toRemoveEntry = false);
+void compactProfile(std::string dat_path);
+void buildHashStore();
 void updateDats(bool download = false);
 void listProfilesWithDate();
 
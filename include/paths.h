@@ -1,3 +1,5 @@
+#include <vector>
+
 #ifndef PATHS_H
 #define PATHS_H
 
@@ -17,7 +19,8 @@ extern std::string dats_path; // place your DATs here
 extern std::string dats_new_path; // place new DATs here
 extern std::string fix_path; // fixDATs are output here
 extern std::string headers_path; // place your header files here
-extern std::string rebuild_path; // places your files to be rebuilt here
+extern std::string rebuild_path; // places your files to be rebuilt here (the first of rebuild_paths)
+extern std::vector<std::string> rebuild_paths; // all folders with files to be rebuilt (rebuild can be a list of folders in the config file, e.g. dumps on different disks)
 extern std::string tmp_path; // temporary place where files are stored for further operations (should be empty)
 
 #endif
\ No newline at end of file
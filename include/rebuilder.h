@@ -1,7 +1,31 @@
 #ifndef REBUILDER_H
 #define REBUILDER_H
 
-void rebuild(std::string dat_path, std::string folder_path, bool toRemove);
+/*
+ * rebuildMatch
+ *
+ * chain: names of archives a file is in, from the archive in rebuild folder down, followed by its name in the last one (empty if the file is not in an archive)
+ * rows: indexes of entries in DAT the file is rebuilt to
+ */
+struct rebuildMatch {
+  std::vector<std::string> chain;
+  std::vector<int> rows;
+};
+
+/*
+ * rebuildJournal
+ *
+ * hashed: key is path of file in rebuild folder, value is its size, modification time, whether it is an archive, and the roms found in it
+ * committed: indexes of DAT entries (in the DATs of the run, one after another) whose roms were added to their sets
+ */
+struct rebuildJournal {
+  std::map<std::string, std::tuple<std::string, std::string, int, std::vector<rebuildMatch>>> hashed;
+  std::vector<int> committed;
+};
+
+void rebuild(std::string dat_path, std::string folder_path, bool toRemove, bool sorted = false);
+void rebuild(std::vector<std::tuple<std::string, std::string>> profiles, bool toRemove, bool sorted = false);
+void clearTmpFolder();
 void recursiveExtractCompressedFiles(std::string path);
 
 #endif
\ No newline at end of file
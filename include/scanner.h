@@ -1,14 +1,36 @@
 #include <set>
 
+#include <container.h>
+
 #ifndef SCANNER_H
 #define SCANNER_H
 
+/*
+ * scanAction
+ *
+ * type: "backup" (rom does not match DAT, so it is moved to backup folder), "rename" (rom is renamed within its set) or "move" (rom is moved to another set, and renamed if needed)
+ * set_name: set name of rom (name of zip it is in)
+ * rom_name: rom name of rom (name in zip)
+ * new_set_name: set name rom belongs to (same as set_name for "backup" and "rename")
+ * new_rom_name: rom name rom should have (same as rom_name for "backup")
+ */
+struct scanAction {
+  std::string type;
+  std::string set_name;
+  std::string rom_name;
+  std::string new_set_name;
+  std::string new_rom_name;
+};
+
 std::set<std::string> getAllFilesInDir2(const std::string &dirPath);
 void removeEmptyDirs(const std::string &dirPath);
 std::vector<std::string> diff(std::set<std::string> s1, std::set<std::string> s2, int req);
-std::tuple<int, int, int, int> countSetsRoms(cacheData cache_data);
+std::tuple<int, int, int, int> countSetsRoms(const cacheData &cache_data);
+std::tuple<int, int, int, int> recountSetsRoms(const cacheData &cache_data);
 void updateCacheCount(std::string dat_path, std::string cache_path, std::string folder_path, std::tuple<int, int, int, int> count);
 void printCount(std::tuple<int, int, int, int> count);
-void scan(std::string dat_path, std::string folder_path);
+std::string describeAction(const scanAction &action, std::string folder_path, const std::map<std::string, setContainer> &containers, bool done);
+void executePlan(std::string folder_path, const std::vector<scanAction> &plan, bool sorted = false);
+void scan(std::string dat_path, std::string folder_path, bool dry_run = false, bool quick = false, bool verify = false, const std::set<std::string> &changed_sets = {}, bool update_store = true, bool sorted = false);
 
 #endif
\ No newline at end of file
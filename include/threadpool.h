@@ -0,0 +1,11 @@
+#include <functional>
+#include <vector>
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+int getNoOfWorkers();
+void parallelFor(int no_of_jobs, std::function<void(int job, int worker)> run_job);
+void parallelForQueues(const std::vector<std::vector<int>> &queues, std::function<void(int job, int worker)> run_job);
+
+#endif
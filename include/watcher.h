@@ -0,0 +1,6 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+void watch(std::vector<std::tuple<std::string, std::string>> profiles);
+
+#endif
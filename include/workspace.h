@@ -0,0 +1,52 @@
+#include <map>
+#include <set>
+#include <ctime>
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+/*
+ * workspaceEntry
+ *
+ * data: contents of the file (if it is held in memory)
+ * path: path to the file in spill_dir if it was written to disk, "" if it is held in memory
+ * size: size of the file
+ * mtime: last modification time of the file
+ */
+struct workspaceEntry {
+  std::string data;
+  std::string path;
+  unsigned long long size;
+  time_t mtime;
+};
+
+/*
+ * workspace
+ *
+ * entries: key is name of file (as in a zip, e.g. "files/a.rom"), value is the file
+ * spill_dir: directory that files are written to once more than spill_threshold bytes are held in memory (*Path must end with a forward slash)
+ * spill_threshold: number of bytes that can be held in memory
+ * in_memory: number of bytes held in memory
+ * spilled: number of files written to spill_dir so far (used to name them)
+ */
+struct workspace {
+  std::map<std::string, workspaceEntry> entries;
+  std::string spill_dir;
+  unsigned long long spill_threshold;
+  unsigned long long in_memory;
+  int spilled;
+};
+
+void moveFile(std::string from, std::string to);
+void cloneFile(std::string from, std::string to);
+void initWorkspace(workspace &ws, std::string spill_dir, unsigned long long spill_threshold = 1024 * 1024 * 16);
+bool extractToWorkspace(workspace &ws, std::string filename, const std::set<std::string> &names = {});
+bool addFileToWorkspace(workspace &ws, std::string path, std::string name, bool keep = false);
+bool renameInWorkspace(workspace &ws, std::string name, std::string new_name);
+bool moveToWorkspace(workspace &from, std::string name, workspace &to, std::string new_name);
+bool writeFromWorkspace(workspace &ws, std::string name, std::string path);
+void writeWorkspaceToDir(workspace &ws, std::string dir);
+std::vector<std::string> hashInWorkspace(const workspace &ws, std::string name, int start_offset = -1, std::vector<std::tuple<int, std::string>> data = {});
+void clearWorkspace(workspace &ws);
+
+#endif
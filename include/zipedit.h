@@ -0,0 +1,16 @@
+#include <map>
+
+#include <workspace.h>
+
+#ifndef ZIPEDIT_H
+#define ZIPEDIT_H
+
+std::vector<std::string> getZipEntryNames(std::string zip_path);
+bool repackZip(std::string destination, std::vector<std::tuple<std::string, std::string, std::string>> members, std::string compression_level = "2");
+bool renameInZip(std::string zip_path, const std::map<std::string, std::string> &renames);
+bool addToZip(std::string zip_path, std::vector<std::string> filenames, std::string rootfolder, std::string compression_level, bool sorted = false);
+bool appendZip(std::string zip_path, std::vector<std::tuple<std::string, std::string, std::string>> members, std::string compression_level = "2", bool sorted = false);
+bool writeWorkspaceZip(std::string zip_path, const workspace &ws, std::string compression_level = "2");
+std::string getCentralDirCRC32(std::string zip_path);
+
+#endif
@@ -4,18 +4,26 @@
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <set>
+#include <filesystem>
 
 #include "../libs/zip/src/zip.h"
 
 #include <fcntl.h>
 #include "/usr/include/archive.h"
 #include <archive_entry.h>
+#include <lzma.h>
+
+#include <gethashes.h>
+
+namespace filesys = std::filesystem;
 
 /*
  * Gets info from a zip file
  *
  * Arguments:
  *     zip_path : Path to zip file
+ *     sizes (Optional) : Map that size of each file (in decimal) is put in, with key as file name
  * 
  * Returns:
  *     data : Map with key as file name and value as CRC32.
@@ -23,7 +31,7 @@
  * Notes:
  *     Uses library: https://github.com/kuba--/zip   
  */
-std::map<std::string, std::string> getInfoFromZip(std::string zip_path){
+std::map<std::string, std::string> getInfoFromZip(std::string zip_path, std::map<std::string, std::string> *sizes){
   struct zip_t *zip = zip_open(zip_path.c_str(), 0, 'r');
   std::map<std::string, std::string> data;
 
@@ -47,6 +55,9 @@ std::map<std::string, std::string> getInfoFromZip(std::string zip_path){
       
       if(zip_entry_isdir(zip) == 0){ // current zip entry is not a directory
         data[filename] = crc32sum;
+        if(sizes != nullptr){
+          (*sizes)[filename] = std::to_string(zip_entry_size(zip));
+        }
       }
     }
     zip_entry_close(zip);
@@ -99,6 +110,619 @@ std::vector<std::string> list_archive(std::string filename) {
   return filenames;
 }
 
+/*
+ * Hashes files in an archive (e.g. zip/7z) without extracting them; each file is hashed as it is decompressed
+ *
+ * Arguments:
+ *     filename : Path to archive
+ *     start_offset (Optional) : Offset to start calculating hash from (in decimal); see getHashes()
+ *     data (Optional) : Vector of tuples containing offset (in decimal) and their expected values (in lowercase); see getHashes()
+ *     part (Optional) : Which share of the files to hash (0 to no_of_parts-1)
+ *     no_of_parts (Optional) : Number of shares the files are split into; every no_of_parts-th file (starting from the part-th) is hashed and the rest are skipped, so an archive can be hashed by several threads at once
+ *     names (Optional) : Names of files to hash; if not empty, other files are skipped
+ *
+ * Returns:
+ *     hashes : Map with key as file name, value as vector containing file size, CRC32, MD5, SHA1 (as getHashes()), followed by CRC32 of the whole file (with header, as in a zip's central directory). Value is an empty vector if the file could not be decompressed.
+ */
+std::map<std::string, std::vector<std::string>> hashArchive(std::string filename, int start_offset, std::vector<std::tuple<int, std::string>> data, int part, int no_of_parts, const std::set<std::string> &names) {
+  struct archive *a;
+  struct archive_entry *entry;
+  std::map<std::string, std::vector<std::string>> hashes;
+
+  int resume = 0; // index of file to carry on from when the archive is reopened
+  for (bool reopen = true; reopen;) {
+    reopen = false;
+    a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+    if (archive_read_open_filename(a, filename.c_str(), 102400) != ARCHIVE_OK) {
+      archive_read_free(a);
+      return hashes;
+    }
+
+    int index = 0; // index of file in archive (directories are not counted)
+    int r;
+    while ((r = archive_read_next_header(a, &entry)) == ARCHIVE_OK || r == ARCHIVE_WARN) {
+      if (archive_entry_filetype(entry) == AE_IFDIR) {
+        archive_read_data_skip(a);
+        continue;
+      }
+      int current = index++;
+      if (current < resume || current % no_of_parts != part || (!(names.empty()) && !(names.count(archive_entry_pathname(entry))))) {
+        archive_read_data_skip(a);
+        continue;
+      }
+
+      hashState state;
+      initHashes(state, start_offset, data);
+      const void *buff;
+      size_t size;
+      la_int64_t offset;
+      while ((r = archive_read_data_block(a, &buff, &size, &offset)) == ARCHIVE_OK) {
+        updateHashes(state, static_cast<const char *>(buff), size);
+      }
+
+      std::string name = archive_entry_pathname(entry);
+      if (r == ARCHIVE_EOF) {
+        hashes[name] = finishHashes(state);
+        hashes[name].push_back(getRawCRC32(state));
+      } else { // data is corrupted (e.g. bad CRC32, or can't be inflated)
+        hashes[name] = {};
+        if (r == ARCHIVE_FATAL) { // archive can't be read any further, so reopen it and carry on from the next file
+          resume = current + 1;
+          reopen = true;
+          break;
+        }
+      }
+    }
+    archive_read_free(a);
+  }
+
+  return hashes;
+}
+
+/*
+ * Reads parts of a 7z header; see getInfoFrom7z()
+ *
+ * Notes:
+ *     Format is described in 7-Zip's DOC/7zFormat.txt
+ */
+struct reader7z {
+  std::string buf;
+  size_t pos;
+  bool ok;
+};
+
+unsigned int read7zByte(reader7z &r){
+  if(r.pos >= r.buf.size()){
+    r.ok = false;
+    return 0;
+  }
+  return (unsigned char)r.buf[r.pos++];
+}
+
+unsigned long long read7zNumber(reader7z &r){ // first byte tells how many bytes follow
+  unsigned int first = read7zByte(r);
+  unsigned int mask = 0x80;
+  unsigned long long value = 0;
+  for(int i = 0; i < 8; i++){
+    if((first & mask) == 0){
+      return value | ((unsigned long long)(first & (mask - 1)) << (8 * i));
+    }
+    value |= (unsigned long long)read7zByte(r) << (8 * i);
+    mask >>= 1;
+  }
+  return value;
+}
+
+unsigned long long read7zUInt(reader7z &r, int bytes){
+  unsigned long long value = 0;
+  for(int i = 0; i < bytes; i++){
+    value |= (unsigned long long)read7zByte(r) << (8 * i);
+  }
+  return value;
+}
+
+std::vector<bool> read7zBits(reader7z &r, unsigned long long count){
+  std::vector<bool> bits(count);
+  unsigned int byte = 0;
+  for(unsigned long long i = 0; i < count && r.ok; i++){
+    if(i % 8 == 0){
+      byte = read7zByte(r);
+    }
+    bits[i] = byte & (0x80 >> (i % 8));
+  }
+  return bits;
+}
+
+std::vector<bool> read7zDefined(reader7z &r, unsigned long long count){ // "all defined" byte, followed by bits if not all are
+  if(read7zByte(r)){
+    return std::vector<bool>(count, true);
+  }
+  return read7zBits(r, count);
+}
+
+/*
+ * streams7z
+ *
+ * pack_pos: offset of packed streams (after the 32-byte signature header)
+ * pack_sizes: size of each packed stream
+ * coders: ID and properties of the coder of each folder ("-" as ID if it has more than one coder)
+ * unpack_sizes: unpacked size of each folder
+ * folder_crcs: CRC32 of each folder's unpacked data, -1 if not known
+ * substreams: number of files in each folder
+ * sizes: size of each file (in order)
+ * crcs: CRC32 of each file (in order), -1 if not known
+ */
+struct streams7z {
+  unsigned long long pack_pos = 0;
+  std::vector<unsigned long long> pack_sizes;
+  std::vector<std::tuple<std::string, std::string>> coders;
+  std::vector<unsigned long long> unpack_sizes;
+  std::vector<long long> folder_crcs;
+  std::vector<unsigned long long> substreams;
+  std::vector<unsigned long long> sizes;
+  std::vector<long long> crcs;
+};
+
+bool read7zStreamsInfo(reader7z &r, streams7z &s){
+  unsigned int type = read7zByte(r);
+  if(type == 0x06){ // PackInfo
+    s.pack_pos = read7zNumber(r);
+    unsigned long long no_of_pack_streams = read7zNumber(r);
+    if(no_of_pack_streams > r.buf.size()){ // each needs at least a byte for its size
+      return false;
+    }
+    s.pack_sizes.resize(no_of_pack_streams);
+    while(r.ok && (type = read7zByte(r)) != 0x00){
+      if(type == 0x09){ // sizes
+        for(unsigned long long i = 0; i < s.pack_sizes.size() && r.ok; i++){
+          s.pack_sizes[i] = read7zNumber(r);
+        }
+      } else if (type == 0x0A){ // CRCs of packed streams (not needed)
+        std::vector<bool> defined = read7zDefined(r, s.pack_sizes.size());
+        r.pos += 4 * std::count(defined.begin(), defined.end(), true);
+      } else {
+        return false;
+      }
+    }
+    type = read7zByte(r);
+  }
+
+  if(type == 0x07){ // UnpackInfo
+    if(read7zByte(r) != 0x0B){ // Folder
+      return false;
+    }
+    unsigned long long no_of_folders = read7zNumber(r);
+    if(read7zByte(r) != 0x00 || no_of_folders > r.buf.size()){ // external
+      return false;
+    }
+    std::vector<unsigned long long> no_of_outputs(no_of_folders); // outputs of all coders of each folder
+    std::vector<unsigned long long> main_output(no_of_folders); // index of output that is the folder's unpacked data (not bound to another coder)
+    for(unsigned long long i = 0; i < no_of_folders && r.ok; i++){
+      unsigned long long no_of_coders = read7zNumber(r);
+      unsigned long long no_of_inputs = 0;
+      if(no_of_coders == 0 || no_of_coders > 64){
+        return false;
+      }
+      for(unsigned long long j = 0; j < no_of_coders && r.ok; j++){
+        unsigned int flags = read7zByte(r);
+        std::string id = r.buf.substr(std::min(r.pos, r.buf.size()), flags & 0x0F);
+        r.pos += flags & 0x0F;
+        unsigned long long inputs = 1;
+        unsigned long long outputs = 1;
+        if(flags & 0x10){ // complex coder
+          inputs = read7zNumber(r);
+          outputs = read7zNumber(r);
+          if(inputs > 64 || outputs > 64){
+            return false;
+          }
+        }
+        std::string props;
+        if(flags & 0x20){
+          unsigned long long props_size = read7zNumber(r);
+          if(props_size > r.buf.size()){
+            return false;
+          }
+          props = r.buf.substr(std::min(r.pos, r.buf.size()), props_size);
+          r.pos += props_size;
+        }
+        no_of_inputs += inputs;
+        no_of_outputs[i] += outputs;
+        if(no_of_outputs[i] > 64){
+          return false;
+        }
+        if(j == 0){
+          s.coders.push_back(std::make_tuple(no_of_coders == 1 ? id : "-", props)); // folders with more than one coder (e.g. BCJ filter followed by LZMA) are not decoded here
+        }
+      }
+      if(no_of_inputs + 1 < no_of_outputs[i]){ // every output but one is bound to an input
+        return false;
+      }
+      std::vector<bool> bound(no_of_outputs[i]);
+      for(unsigned long long j = 0; j + 1 < no_of_outputs[i] && r.ok; j++){ // bind pairs: input, output
+        read7zNumber(r);
+        unsigned long long output = read7zNumber(r);
+        if(output < bound.size()){
+          bound[output] = true;
+        }
+      }
+      main_output[i] = std::find(bound.begin(), bound.end(), false) - bound.begin();
+      unsigned long long no_of_packed = no_of_inputs - (no_of_outputs[i] - 1);
+      for(unsigned long long j = 0; no_of_packed > 1 && j < no_of_packed && r.ok; j++){ // indexes of packed streams
+        read7zNumber(r);
+      }
+    }
+    if(read7zByte(r) != 0x0C){ // CodersUnpackSize
+      return false;
+    }
+    for(unsigned long long i = 0; i < no_of_folders && r.ok; i++){
+      for(unsigned long long j = 0; j < no_of_outputs[i] && r.ok; j++){
+        unsigned long long size = read7zNumber(r);
+        if(j == main_output[i]){
+          s.unpack_sizes.push_back(size);
+        }
+      }
+    }
+    s.folder_crcs.assign(no_of_folders, -1);
+    while(r.ok && (type = read7zByte(r)) != 0x00){
+      if(type == 0x0A){ // CRCs of folders
+        std::vector<bool> defined = read7zDefined(r, no_of_folders);
+        for(unsigned long long i = 0; i < no_of_folders && r.ok; i++){
+          if(defined[i]){
+            s.folder_crcs[i] = read7zUInt(r, 4);
+          }
+        }
+      } else {
+        return false;
+      }
+    }
+    type = read7zByte(r);
+  }
+
+  s.substreams.assign(s.unpack_sizes.size(), 1);
+  bool has_sizes = false;
+  if(type == 0x08){ // SubStreamsInfo
+    type = read7zByte(r);
+    if(type == 0x0D){ // number of files in each folder
+      unsigned long long no_of_substreams = 0;
+      for(unsigned long long i = 0; i < s.substreams.size() && r.ok; i++){
+        s.substreams[i] = read7zNumber(r);
+        no_of_substreams += std::min<unsigned long long>(s.substreams[i], r.buf.size() + 1);
+        if(no_of_substreams > r.buf.size()){ // each file needs at least a byte for its name
+          return false;
+        }
+      }
+      type = read7zByte(r);
+    }
+    for(int i = 0; i < s.unpack_sizes.size() && r.ok; i++){
+      if(s.substreams[i] == 0){
+        continue;
+      }
+      unsigned long long sum = 0;
+      for(unsigned long long j = 1; j < s.substreams[i] && type == 0x09 && r.ok; j++){ // sizes of all but the last file are listed
+        s.sizes.push_back(read7zNumber(r));
+        sum += s.sizes.back();
+        if(sum > s.unpack_sizes[i]){
+          return false;
+        }
+      }
+      s.sizes.push_back(s.unpack_sizes[i] - sum);
+    }
+    has_sizes = true;
+    if(type == 0x09){
+      type = read7zByte(r);
+    }
+
+    // CRCs of files, except files that are the only one in a folder with a CRC
+    unsigned long long no_of_crcs = 0;
+    for(int i = 0; i < s.unpack_sizes.size(); i++){
+      if(!(s.substreams[i] == 1 && s.folder_crcs[i] != -1)){
+        no_of_crcs += s.substreams[i];
+      }
+    }
+    std::vector<long long> listed_crcs(no_of_crcs, -1);
+    while(r.ok && type != 0x00){
+      if(type == 0x0A){
+        std::vector<bool> defined = read7zDefined(r, no_of_crcs);
+        for(unsigned long long i = 0; i < no_of_crcs && r.ok; i++){
+          if(defined[i]){
+            listed_crcs[i] = read7zUInt(r, 4);
+          }
+        }
+      } else {
+        return false;
+      }
+      type = read7zByte(r);
+    }
+    unsigned long long k = 0;
+    for(int i = 0; i < s.unpack_sizes.size(); i++){
+      if(s.substreams[i] == 1 && s.folder_crcs[i] != -1){
+        s.crcs.push_back(s.folder_crcs[i]);
+      } else {
+        for(unsigned long long j = 0; j < s.substreams[i]; j++){
+          s.crcs.push_back(listed_crcs[k++]);
+        }
+      }
+    }
+    type = read7zByte(r);
+  }
+  if(!(has_sizes)){ // one file in each folder
+    s.sizes = s.unpack_sizes;
+    s.crcs = s.folder_crcs;
+  }
+  return r.ok && type == 0x00;
+}
+
+/*
+ * Decodes a folder of a 7z (only used for the header, which is small)
+ *
+ * Arguments:
+ *     path : Path to 7z file
+ *     s : Streams of the folder, as read by read7zStreamsInfo()
+ *     output : String that the decoded data is put in
+ *
+ * Returns:
+ *     true if the folder was decoded, false if not (e.g. unsupported coder, or CRC32 does not match)
+ */
+bool decode7zFolder(std::string path, const streams7z &s, std::string &output){
+  if(s.coders.size() != 1 || s.pack_sizes.size() != 1 || s.unpack_sizes.size() != 1 || s.pack_sizes[0] > 1024 * 1024 * 64 || s.unpack_sizes[0] > 1024 * 1024 * 64){
+    return false;
+  }
+  std::string packed(s.pack_sizes[0], '\0');
+  std::ifstream file(path, std::ios::binary);
+  file.seekg(32 + s.pack_pos);
+  if(!(file.read(&packed[0], packed.size()))){
+    return false;
+  }
+
+  std::string id = std::get<0>(s.coders[0]);
+  std::string props = std::get<1>(s.coders[0]);
+  if(id == std::string(1, '\0')){ // copy
+    output = packed;
+  } else if (id == "\x21" || id == "\x03\x01\x01"){ // LZMA2 or LZMA
+    lzma_filter filters[2];
+    filters[0].id = id == "\x21" ? LZMA_FILTER_LZMA2 : LZMA_FILTER_LZMA1;
+    filters[0].options = nullptr;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    if(lzma_properties_decode(&filters[0], nullptr, reinterpret_cast<const uint8_t *>(props.data()), props.size()) != LZMA_OK){
+      return false;
+    }
+    lzma_stream strm = LZMA_STREAM_INIT;
+    bool ok = lzma_raw_decoder(&strm, filters) == LZMA_OK;
+    free(filters[0].options);
+    output.assign(s.unpack_sizes[0], '\0');
+    if(ok){
+      strm.next_in = reinterpret_cast<const uint8_t *>(packed.data());
+      strm.avail_in = packed.size();
+      strm.next_out = reinterpret_cast<uint8_t *>(&output[0]);
+      strm.avail_out = output.size();
+      lzma_ret ret = lzma_code(&strm, LZMA_FINISH);
+      ok = (ret == LZMA_OK || ret == LZMA_STREAM_END || ret == LZMA_BUF_ERROR) && strm.total_out == output.size();
+    }
+    lzma_end(&strm);
+    if(!(ok)){
+      return false;
+    }
+  } else {
+    return false;
+  }
+  return s.folder_crcs[0] == -1 || (uint32_t)s.folder_crcs[0] == lzma_crc32(reinterpret_cast<const uint8_t *>(output.data()), output.size(), 0);
+}
+
+/*
+ * Converts a UTF-16LE string (as names are stored in 7z) to UTF-8
+ */
+std::string utf16ToUtf8(const std::string &utf16){
+  std::string utf8;
+  for(size_t i = 0; i + 1 < utf16.size(); i += 2){
+    unsigned int c = (unsigned char)utf16[i] | ((unsigned char)utf16[i + 1] << 8);
+    if(c >= 0xD800 && c < 0xDC00 && i + 3 < utf16.size()){ // surrogate pair
+      unsigned int low = (unsigned char)utf16[i + 2] | ((unsigned char)utf16[i + 3] << 8);
+      c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+      i += 2;
+    }
+    if(c < 0x80){
+      utf8 += (char)c;
+    } else if (c < 0x800){
+      utf8 += (char)(0xC0 | (c >> 6));
+      utf8 += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000){
+      utf8 += (char)(0xE0 | (c >> 12));
+      utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+      utf8 += (char)(0x80 | (c & 0x3F));
+    } else {
+      utf8 += (char)(0xF0 | (c >> 18));
+      utf8 += (char)(0x80 | ((c >> 12) & 0x3F));
+      utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+      utf8 += (char)(0x80 | (c & 0x3F));
+    }
+  }
+  return utf8;
+}
+
+/*
+ * Reads file names, sizes and CRC32s from the header of a 7z file
+ *
+ * Arguments:
+ *     path : Path to 7z file
+ *     data : Map that file names and CRC32s are put in (same format as getInfoFromZip())
+ *     sizes : Map that file sizes are put in, or nullptr (see getInfoFromZip())
+ *
+ * Returns:
+ *     true if the header was read, false if not (e.g. encrypted header, or files without CRC32)
+ */
+bool readInfoFrom7z(std::string path, std::map<std::string, std::string> &data, std::map<std::string, std::string> *sizes){
+  std::ifstream file(path, std::ios::binary);
+  char signature_header[32];
+  if(!(file.read(signature_header, 32)) || std::string(signature_header, 6) != "7z\xBC\xAF\x27\x1C"){
+    return false;
+  }
+  reader7z r;
+  r.buf.assign(signature_header + 12, 20);
+  r.pos = 0;
+  r.ok = true;
+  unsigned long long next_header_ofs = read7zUInt(r, 8);
+  unsigned long long next_header_size = read7zUInt(r, 8);
+  if(next_header_size == 0){ // empty archive
+    return true;
+  }
+  if(next_header_size > 1024 * 1024 * 64){
+    return false;
+  }
+  r.buf.assign(next_header_size, '\0');
+  file.seekg(32 + next_header_ofs);
+  if(!(file.read(&r.buf[0], next_header_size))){
+    return false;
+  }
+  r.pos = 0;
+
+  unsigned int type = read7zByte(r);
+  for(int i = 0; type == 0x17; i++){ // EncodedHeader: header is packed like a folder of files
+    streams7z header_streams;
+    if(i == 4){ // a header packed in itself would never end
+      return false;
+    }
+    std::string header;
+    if(!(read7zStreamsInfo(r, header_streams)) || header_streams.unpack_sizes.size() != 1 || !(decode7zFolder(path, header_streams, header))){
+      return false;
+    }
+    r.buf = header;
+    r.pos = 0;
+    type = read7zByte(r);
+  }
+  if(type != 0x01){ // Header
+    return false;
+  }
+
+  streams7z s;
+  type = read7zByte(r);
+  if(type == 0x02){ // ArchiveProperties (not needed)
+    while(r.ok && read7zNumber(r) != 0){
+      unsigned long long size = read7zNumber(r);
+      if(size > r.buf.size() - std::min(r.pos, r.buf.size())){
+        return false;
+      }
+      r.pos += size;
+    }
+    type = read7zByte(r);
+  }
+  if(type == 0x03){ // AdditionalStreamsInfo (not needed)
+    streams7z additional;
+    if(!(read7zStreamsInfo(r, additional))){
+      return false;
+    }
+    type = read7zByte(r);
+  }
+  if(type == 0x04){ // MainStreamsInfo
+    if(!(read7zStreamsInfo(r, s))){
+      return false;
+    }
+    type = read7zByte(r);
+  }
+  if(type != 0x05){ // FilesInfo; an archive with no files has none
+    return r.ok && type == 0x00;
+  }
+
+  unsigned long long no_of_files = read7zNumber(r);
+  if(no_of_files > r.buf.size()){
+    return false;
+  }
+  std::vector<bool> empty_stream(no_of_files); // file has no data (directory or empty file)
+  std::vector<bool> empty_file; // for each file in empty_stream, whether it is an empty file (else it is a directory)
+  std::vector<std::string> names;
+  while(r.ok && (type = read7zNumber(r)) != 0x00){
+    unsigned long long size = read7zNumber(r);
+    if(size > r.buf.size() - std::min(r.pos, r.buf.size())){
+      return false;
+    }
+    size_t end = r.pos + size;
+    if(type == 0x0E){ // EmptyStream
+      empty_stream = read7zBits(r, no_of_files);
+    } else if (type == 0x0F){ // EmptyFile
+      empty_file = read7zBits(r, std::count(empty_stream.begin(), empty_stream.end(), true));
+    } else if (type == 0x11){ // Names
+      if(read7zByte(r) != 0x00){ // external
+        return false;
+      }
+      std::string name;
+      while(r.ok && r.pos + 1 < end && names.size() < no_of_files){
+        if(r.buf[r.pos] == 0 && r.buf[r.pos + 1] == 0){
+          names.push_back(utf16ToUtf8(name));
+          name.clear();
+        } else {
+          name.append(r.buf, r.pos, 2);
+        }
+        r.pos += 2;
+      }
+    }
+    r.pos = end;
+  }
+  if(!(r.ok) || names.size() != no_of_files){
+    return false;
+  }
+
+  unsigned long long stream = 0; // index of file with data
+  unsigned long long empty = 0; // index of file without data
+  for(unsigned long long i = 0; i < no_of_files; i++){
+    if(empty_stream[i]){
+      if(empty < empty_file.size() && empty_file[empty]){
+        data[names[i]] = ""; // account for blank files in DATs
+        if(sizes != nullptr){
+          (*sizes)[names[i]] = "0";
+        }
+      }
+      empty += 1;
+      continue;
+    }
+    if(stream >= s.sizes.size() || s.crcs[stream] == -1){
+      return false;
+    }
+    char crc32[9];
+    snprintf(crc32, sizeof(crc32), "%08llX", s.crcs[stream]);
+    data[names[i]] = s.sizes[stream] == 0 ? "" : crc32;
+    if(sizes != nullptr){
+      (*sizes)[names[i]] = std::to_string(s.sizes[stream]);
+    }
+    stream += 1;
+  }
+  return true;
+}
+
+/*
+ * Gets info from a 7z file
+ *
+ * Arguments:
+ *     path : Path to 7z file
+ *     sizes (Optional) : Map that size of each file is put in (see getInfoFromZip())
+ *
+ * Returns:
+ *     data : Map with key as file name and value as CRC32 (same format as getInfoFromZip())
+ *
+ * Notes:
+ *     CRC32s are read from the 7z's header, so files are not decompressed (the header itself is decompressed if it is packed). If the header can't be read, every file is decompressed to get its CRC32 instead.
+ */
+std::map<std::string, std::string> getInfoFrom7z(std::string path, std::map<std::string, std::string> *sizes){
+  std::map<std::string, std::string> data;
+  if(readInfoFrom7z(path, data, sizes)){
+    return data;
+  }
+
+  data.clear();
+  if(sizes != nullptr){
+    sizes->clear();
+  }
+  for(auto i: hashArchive(path, -1, {}, 0, 1, {})){
+    if(!(i.second.empty())){
+      data[i.first] = i.second[4];
+      if(sizes != nullptr){
+        (*sizes)[i.first] = i.second[0];
+      }
+    }
+  }
+  return data;
+}
+
 // needed for extract
 int copy_data(struct archive *ar, struct archive *aw) {
   int r;
@@ -128,6 +752,7 @@ int copy_data(struct archive *ar, struct archive *aw) {
  *     destination : Path to folder where you want the extracted file to go (*Path must end with a forward slash)
  * 
  * Notes:
+ *     Files whose data is corrupted are left out (the rest are still extracted)
  *     Taken from https://github.com/libarchive/libarchive/wiki/Examples#A_Complete_Extractor, https://stackoverflow.com/questions/8384266/libarchive-extract-to-specified-directory
  *     archive_read_support_compression_all() is deprecated, replaced with archive_read_support_filter_all() as per https://github.com/google/file-system-stress-testing/commit/0b4cb3e9c42d67c1d40bc66f72d45152cd5c563b
 */
@@ -144,46 +769,63 @@ void extract(std::string filename, std::string destination) {
   flags |= ARCHIVE_EXTRACT_ACL;
   flags |= ARCHIVE_EXTRACT_FFLAGS;
 
-  a = archive_read_new();
-  archive_read_support_format_all(a);
-  archive_read_support_filter_all(a);
   ext = archive_write_disk_new();
   archive_write_disk_set_options(ext, flags);
   archive_write_disk_set_standard_lookup(ext);
-  if ((r = archive_read_open_filename(a, filename.c_str(), 10240)))
-    exit(1);
-  for (;;) {
-    r = archive_read_next_header(a, &entry);
-    if (r == ARCHIVE_EOF)
-      break;
-    if (r < ARCHIVE_OK)
-      fprintf(stderr, "%s\n", archive_error_string(a));
-    if (r < ARCHIVE_WARN)
+  int resume = 0; // index of file to carry on from when the archive is reopened
+  for (bool reopen = true; reopen;) {
+    reopen = false;
+    a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+    if ((r = archive_read_open_filename(a, filename.c_str(), 10240)))
       exit(1);
+    for (int index = 0;; index++) {
+      r = archive_read_next_header(a, &entry);
+      if (r == ARCHIVE_EOF)
+        break;
+      if (r < ARCHIVE_OK)
+        fprintf(stderr, "%s\n", archive_error_string(a));
+      if (r < ARCHIVE_WARN)
+        exit(1);
+      if (index < resume) {
+        archive_read_data_skip(a);
+        continue;
+      }
 
-    // extract to specified directory
-    const char* currentFile = archive_entry_pathname(entry);
-    const std::string fullOutputPath = destination + currentFile;
-    archive_entry_set_pathname(entry, fullOutputPath.c_str());
-    
-    r = archive_write_header(ext, entry);
-    if (r < ARCHIVE_OK)
-      fprintf(stderr, "%s\n", archive_error_string(ext));
-    else if (archive_entry_size(entry) > 0) {
-      r = copy_data(a, ext);
+      // extract to specified directory
+      const char* currentFile = archive_entry_pathname(entry);
+      const std::string fullOutputPath = destination + currentFile;
+      archive_entry_set_pathname(entry, fullOutputPath.c_str());
+
+      r = archive_write_header(ext, entry);
+      if (r < ARCHIVE_OK)
+        fprintf(stderr, "%s\n", archive_error_string(ext));
+      else if (archive_entry_size(entry) > 0) {
+        r = copy_data(a, ext);
+        if (r < ARCHIVE_WARN) { // data is corrupted, so the file is left out
+          fprintf(stderr, "%s: %s\n", fullOutputPath.c_str(), archive_error_string(a));
+          archive_write_finish_entry(ext);
+          filesys::remove(fullOutputPath);
+          if (r == ARCHIVE_FATAL) { // archive can't be read any further, so reopen it and carry on from the next file
+            resume = index + 1;
+            reopen = true;
+            break;
+          }
+          continue;
+        }
+        if (r < ARCHIVE_OK)
+          fprintf(stderr, "%s\n", archive_error_string(ext));
+      }
+      r = archive_write_finish_entry(ext);
       if (r < ARCHIVE_OK)
         fprintf(stderr, "%s\n", archive_error_string(ext));
       if (r < ARCHIVE_WARN)
         exit(1);
     }
-    r = archive_write_finish_entry(ext);
-    if (r < ARCHIVE_OK)
-      fprintf(stderr, "%s\n", archive_error_string(ext));
-    if (r < ARCHIVE_WARN)
-      exit(1);
+    archive_read_close(a);
+    archive_read_free(a);
   }
-  archive_read_close(a);
-  archive_read_free(a);
   archive_write_close(ext);
   archive_write_free(ext);
 }
@@ -3,8 +3,20 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <numeric>
+#include <string_view>
+#include <unordered_set>
+#include <cstring>
 
-#include <pugixml.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "../libs/zip/src/miniz.h"
 
 #include <paths.h>
 #include <dir2dat.h>
@@ -47,7 +59,7 @@ void createNewCache(std::string dat_path, std::string folder_path){
   std::ofstream file(cache_path);
   file << "romorganizer cache version 1.0" << std::endl;
   file << "\"" << datfilename << "\" \"" << folder_path << "\" \"" << "0" << "\" \"" << "0" << "\" \"" << "0" << "\" \"" << "0" << "\"" << std::endl;
-  file << std::endl;
+  file << "\"" << "0" << "\" \"" << "00000000" << "\"" << std::endl; // no. of entries, CRC32 of entries
   file.close();
 }
 
@@ -90,123 +102,339 @@ bool hasUpdate(std::string dat_path){
 }
 
 /*
- * Removes lines from cache file
+ * Formats an entry the way it is stored in cache
  *
  * Arguments:
- *     cache_path : Path to cache file
- *     lines_to_keep : Vector containing line numbers to keep
- *     cache_info : Vector containing path to DAT file, path to folder containing roms, set have, set total, rom have, rom total (for second line of cache file)
+ *     set_name, rom_name, crc32, md5, sha1, status : Fields of the entry
+ *
+ * Returns:
+ *     line : Line (ending with a newline) containing the fields quoted with std::quoted(), so getDataFromCache() can read them back even if they contain quotes or backslashes
  */
-void onlyWriteCertainLines(const char *cache_path, std::vector<int> lines_to_keep, std::vector<std::string> cache_info){ 
-  std::ifstream is(cache_path);
-  std::ofstream ofs("temp.txt"); // write to temp file
+std::string formatEntry(const std::string &set_name, const std::string &rom_name, const std::string &crc32, const std::string &md5, const std::string &sha1, const std::string &status){
+  std::stringstream ss;
+  ss << std::quoted(set_name) << " " << std::quoted(rom_name) << " " << std::quoted(crc32) << " " << std::quoted(md5) << " " << std::quoted(sha1) << " " << std::quoted(status) << "\n";
+  return ss.str();
+}
 
-  int line_no = 0;
-  std::string line;
-  while(getline(is,line)){
-    line_no++;
-    if (line_no == 2){ // update dat name in cache
-      ofs << "\"" << cache_info[0] << "\" \"" << cache_info[1] << "\" \"" << cache_info[2] << "\" \"" << cache_info[3] << "\" \"" << cache_info[4] << "\" \"" << cache_info[5] << "\"" << std::endl;
-    }
-    for(int i = 0; i < lines_to_keep.size(); i++) {
-      if (line_no == lines_to_keep[i]) {
-        ofs << line << std::endl; // writes line from cache to output file if line number is in lines_to_keep
-      }
-    }
+/*
+ * Updates the per-set and total counts in cache_data for one entry being added to or removed from it
+ *
+ * Arguments:
+ *     cache_data : Struct containing cache data (see definition in cache.h)
+ *     set_name : Set name of the entry
+ *     status : Status of the entry; only "Passed" counts towards roms have
+ *     delta : 1 if the entry is being added, -1 if it is being removed
+ */
+void updateSetCount(cacheData &cache_data, const std::string &set_name, const std::string &status, int delta){
+  std::tuple<int, int> &count = cache_data.set_count[set_name]; // roms have, roms total for that set
+  bool was_present = std::get<1>(count) > 0;
+  bool was_complete = was_present && std::get<0>(count) == std::get<1>(count);
+
+  if(status == "Passed"){
+    std::get<0>(count) += delta;
+    cache_data.roms_have += delta;
   }
+  std::get<1>(count) += delta;
+  cache_data.roms_total += delta;
+
+  bool is_present = std::get<1>(count) > 0;
+  bool is_complete = is_present && std::get<0>(count) == std::get<1>(count);
+
+  cache_data.sets_total += (int)is_present - (int)was_present;
+  cache_data.sets_have += (int)is_complete - (int)was_complete; // a set counts towards sets have only if we have all the roms in that set
 
-  ofs.close(); 
-  is.close(); 
-  remove(cache_path);  // remove original file
-  rename("temp.txt", cache_path); // rename temp file to original file's name
+  if(!(is_present)){ // no entries left for that set
+    cache_data.set_count.erase(set_name);
+  }
 }
 
 /*
- * Removes lines from cache file
+ * Reads the next field from a line in cache, the same way std::quoted() would (i.e. a field is either a quoted string, where backslash escapes the next character, or a run of non-whitespace characters)
  *
  * Arguments:
- *     cache_path : Path to cache file
- *     lines_to_remove : Vector containing line numbers to remove
+ *     p : Pointer to where reading should start from; moved past the field that is read
+ *     end : Pointer to the end of the line
+ *     scratch : String used to hold the field if it contains escaped characters
+ *     field : Set to the field that is read. Points into the line unless the field had to be unescaped, in which case it points into scratch
+ *
+ * Returns:
+ *     true if a field was read, false if there are no more fields in the line
  */
-void removeLines(const char *cache_path, std::vector<int> lines_to_remove){ 
-  std::ifstream is(cache_path);
-  std::ofstream ofs("temp.txt"); // write to temp file
+bool nextField(const char *&p, const char *end, std::string &scratch, std::string_view &field){
+  while(p < end && isspace((unsigned char)*p)){ // skip whitespace between fields
+    p++;
+  }
+  if(p == end){
+    return false;
+  }
 
-  int line_no = 0;
-  std::string line;
-  while(getline(is,line)){
-    line_no++;
-    if (!(std::find(lines_to_remove.begin(), lines_to_remove.end(), line_no) != lines_to_remove.end())){ // if line number is not in lines_to_remove
-      ofs << line << std::endl; // writes line from cache to output file
+  if(*p != '"'){ // unquoted field
+    const char *start = p;
+    while(p < end && !(isspace((unsigned char)*p))){
+      p++;
     }
+    field = std::string_view(start, p - start);
+    return true;
   }
 
-  ofs.close(); 
-  is.close(); 
-  remove(cache_path);  // remove original file
-  rename("temp.txt", cache_path); // rename temp file to original file's name
-}
+  p++; // skip opening quote
+  const char *start = p;
+  while(p < end && *p != '"' && *p != '\\'){
+    p++;
+  }
+  if(p == end || *p == '"'){ // no escapes in field (most fields), so it can point straight into the line
+    field = std::string_view(start, p - start);
+    if(p < end){
+      p++; // skip closing quote
+    }
+    return true;
+  }
 
+  // field has escaped characters, so copy it to scratch while removing the backslashes
+  scratch.assign(start, p - start);
+  while(p < end && *p != '"'){
+    if(*p == '\\' && p + 1 < end){
+      p++;
+    }
+    scratch.push_back(*p);
+    p++;
+  }
+  if(p < end){
+    p++; // skip closing quote
+  }
+  field = scratch;
+  return true;
+}
 
 /*
  * Gets data from cache
  *
  * Arguments:
  *     dat_path : Path to DAT file
+ *     verify (Optional) : If true, exits if the cache has fewer entries than its third line says it should (i.e. it has been truncated/corrupted)
  * 
  * Returns:
  *     cache_data : Struct containing cache data (see definition in cache.h)
+ *
+ * Notes:
+ *     The cache is mmap()ed and tokenized in place; fields only get copied out of the mapping when they are stored in cache_data, and are only unescaped if they contain a backslash
+ *     Entries are only ever appended to cache, so if there's more than one entry with the same set name and rom name, the last one is used
  */
-cacheData getDataFromCache(std::string dat_path){
+cacheData getDataFromCache(std::string dat_path, bool verify){
   std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
   cacheData cache_data;
 
-  // reading from cache
-  std::ifstream file(cache_path);
-  std::string line;
-  std::vector<std::string> cache;
-  int no_of_lines = 0;
+  int fd = open(cache_path.c_str(), O_RDONLY);
+  if(fd == -1){
+    return cache_data;
+  }
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size == 0){
+    close(fd);
+    return cache_data;
+  }
+  size_t size = st.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // mapping stays valid after the file descriptor is closed
+  if(mapping == MAP_FAILED){
+    std::cout << "Failed to read " << cache_path << std::endl;
+    exit(1);
+  }
+  madvise(mapping, size, MADV_SEQUENTIAL);
 
-  while(getline(file,line)) {
-    no_of_lines++;
+  const char *p = static_cast<const char *>(mapping);
+  const char *end = p + size;
+  int line_no = 0;
+  int no_of_entries = 0; // no. of lines with an entry, including superseded ones
+  std::string_view fields[6]; // set name, rom name, CRC32, MD5, SHA1, status
+  std::string scratch[6]; // holds fields that had to be unescaped
+
+  size_t no_of_rows = std::count(p, end, '\n'); // upper bound of entries in cache, so the vectors are only allocated once
+  cache_data.set_name.reserve(no_of_rows);
+  cache_data.rom_name.reserve(no_of_rows);
+  cache_data.crc32.reserve(no_of_rows);
+  cache_data.md5.reserve(no_of_rows);
+  cache_data.sha1.reserve(no_of_rows);
+  cache_data.status.reserve(no_of_rows);
+  cache_data.set_count.reserve(no_of_rows);
+
+  while(p < end){
+    const char *line_end = static_cast<const char *>(memchr(p, '\n', end - p));
+    if(line_end == nullptr){ // last line without a newline
+      line_end = end;
+    }
+    line_no++;
 
-    std::stringstream ss(line);
-    std::string s;
-    while (ss >> std::quoted(s)) {
-      if(no_of_lines > 3){
-        cache.push_back(s);
-      } else {
-        cache_data.info.push_back(s);
+    if(line_no <= 3){ // first 3 lines of cache are info
+      std::string_view field;
+      while(nextField(p, line_end, scratch[0], field)){
+        cache_data.info.emplace_back(field);
+      }
+    } else {
+      int no_of_fields = 0;
+      while(no_of_fields < 6 && nextField(p, line_end, scratch[no_of_fields], fields[no_of_fields])){
+        no_of_fields++;
+      }
+
+      if(no_of_fields == 6){
+        no_of_entries++;
+        std::string key = entryKey(fields[0], fields[1]);
+        auto it = cache_data.entry_index.find(key);
+        if(it == cache_data.entry_index.end()){ // new entry
+          cache_data.entry_index.emplace(std::move(key), cache_data.set_name.size());
+          cache_data.set_name.emplace_back(fields[0]);
+          cache_data.rom_name.emplace_back(fields[1]);
+          cache_data.crc32.emplace_back(fields[2]);
+          cache_data.md5.emplace_back(fields[3]);
+          cache_data.sha1.emplace_back(fields[4]);
+          cache_data.status.emplace_back(fields[5]);
+          updateSetCount(cache_data, cache_data.set_name.back(), cache_data.status.back(), 1);
+        } else { // entry with same set name and rom name appears earlier in cache, so this one supersedes it
+          int i = it->second;
+          updateSetCount(cache_data, cache_data.set_name[i], cache_data.status[i], -1);
+          cache_data.crc32[i] = fields[2];
+          cache_data.md5[i] = fields[3];
+          cache_data.sha1[i] = fields[4];
+          cache_data.status[i] = fields[5];
+          updateSetCount(cache_data, cache_data.set_name[i], cache_data.status[i], 1);
+          cache_data.dead_rows++;
+        }
+      } else { // blank (or incomplete) line
+        cache_data.dead_rows++;
       }
     }
+
+    p = line_end + 1;
   }
-  file.close();
 
-  for(int i = 0; i < cache.size(); i++){ // spliting cache into set_name, rom_name, crc32, md5, sha1, status
-    switch(i % 6){
-      case 0:
-        cache_data.set_name.push_back(cache[i]);
-        break;
-      case 1:
-        cache_data.rom_name.push_back(cache[i]);
-        break;
-      case 2:
-        cache_data.crc32.push_back(cache[i]);
-        break;
-      case 3:
-        cache_data.md5.push_back(cache[i]);
-        break;
-      case 4:
-        cache_data.sha1.push_back(cache[i]);
-        break;
-      case 5:
-        cache_data.status.push_back(cache[i]);
-    }
+  munmap(mapping, size);
+
+  // the third line of cache has the no. of entries the cache had when it was last written in full; entries are only appended after that, so there can't be fewer
+  if(verify && cache_data.info.size() >= 12 && no_of_entries < std::strtol(cache_data.info[10].c_str(), nullptr, 10)){
+    std::cout << cache_path << " is corrupted (expected at least " << cache_data.info[10] << " entries, found " << no_of_entries << ")." << std::endl;
+    std::cout << "Run romog with (-c | --compact) to keep the entries that are left, or (-D | --delete) to remove the cache, then scan again." << std::endl;
+    exit(0);
   }
 
   return cache_data;
 }
 
+/*
+ * Checks whether the cache needs to be compacted, i.e. whether blank/superseded lines make up a significant part of it
+ *
+ * Arguments:
+ *     cache_data : Struct containing cache data (see definition in cache.h)
+ *
+ * Returns:
+ *     true if the cache should be compacted with writeCache(), false if not
+ */
+bool needsCompaction(const cacheData &cache_data){
+  return cache_data.dead_rows > 0 && cache_data.dead_rows * 4 > cache_data.set_name.size(); // more than 1 dead line for every 4 entries
+}
+
+/*
+ * Writes the whole cache from cache_data, with entries sorted by set name and rom name and without blank/superseded lines. The third line of the cache is set to the no. of entries and the CRC32 of the lines containing them, so the cache can be checked for corruption later.
+ *
+ * Arguments:
+ *     dat_path : Path to DAT file
+ *     cache_data : Struct containing cache data (see definition in cache.h); info is used for the second line of the cache
+ *
+ * Notes:
+ *     The cache is written to a temporary file first, which then replaces the cache, so the cache is never left half-written
+ */
+void writeCache(std::string dat_path, cacheData &cache_data){
+  std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
+  std::string datfilename = std::get<1>(getCachePath(dat_path));
+
+  std::vector<int> order(cache_data.set_name.size()); // indexes of entries, sorted by set name and rom name
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b){
+    if(cache_data.set_name[a] != cache_data.set_name[b]){
+      return cache_data.set_name[a] < cache_data.set_name[b];
+    }
+    return cache_data.rom_name[a] < cache_data.rom_name[b];
+  });
+
+  std::string entries;
+  for(auto i: order){
+    entries += formatEntry(cache_data.set_name[i], cache_data.rom_name[i], cache_data.crc32[i], cache_data.md5[i], cache_data.sha1[i], cache_data.status[i]);
+  }
+  std::stringstream CRC32string;
+  CRC32string << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << mz_crc32(MZ_CRC32_INIT, (const unsigned char *)entries.data(), entries.size());
+
+  // info has the strings from the first line of cache, followed by the second line: DAT name, folder path, set have, set total, rom have, rom total
+  cache_data.info.resize(12, "0");
+  if(cache_data.info[4] == "0"){ // no second line in cache
+    cache_data.info[4] = datfilename;
+  }
+  cache_data.info[10] = std::to_string(order.size());
+  cache_data.info[11] = CRC32string.str();
+
+  std::string tmp_cache_path = cache_path + ".tmp";
+  std::ofstream file(tmp_cache_path);
+  file << "romorganizer cache version 1.0" << std::endl;
+  file << "\"" << cache_data.info[4] << "\" \"" << cache_data.info[5] << "\" \"" << cache_data.info[6] << "\" \"" << cache_data.info[7] << "\" \"" << cache_data.info[8] << "\" \"" << cache_data.info[9] << "\"" << std::endl;
+  file << "\"" << cache_data.info[10] << "\" \"" << cache_data.info[11] << "\"" << std::endl; // no. of entries, CRC32 of entries
+  file << entries;
+  file.close();
+  rename(tmp_cache_path.c_str(), cache_path.c_str()); // replaces cache
+
+  cache_data.dead_rows = 0;
+}
+
+/*
+ * Checks cache for corruption, by comparing the no. of entries and CRC32 on its third line (written by writeCache()) with the entries that follow
+ *
+ * Arguments:
+ *     dat_path : Path to DAT file
+ *
+ * Returns:
+ *     true if the cache is intact (or was written before it had a CRC32 on its third line), false if it is corrupted
+ */
+bool verifyCache(std::string dat_path){
+  std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
+
+  std::ifstream file(cache_path);
+  std::string line;
+  for(int i = 0; i < 3 && getline(file,line); i++) { // reads first 3 lines of cache
+    continue;
+  }
+
+  // line is now the 3rd line of cache
+  std::stringstream ss(line);
+  std::string s;
+  std::vector<std::string> cache_info;
+  while (ss >> std::quoted(s)) {
+    cache_info.push_back(s);
+  }
+  if(cache_info.size() < 2){
+    std::cout << cache_path << " has no CRC32 (written by an older version of romorganizer), unable to verify it" << std::endl;
+    return true;
+  }
+
+  long expected_entries = std::strtol(cache_info[0].c_str(), nullptr, 10);
+  long no_of_entries = 0;
+  mz_ulong crc32 = MZ_CRC32_INIT;
+  while(no_of_entries < expected_entries && getline(file,line)){ // CRC32 covers the entries as written by writeCache(); entries appended after that aren't covered
+    line.push_back('\n');
+    crc32 = mz_crc32(crc32, (const unsigned char *)line.data(), line.size());
+    no_of_entries++;
+  }
+  file.close();
+
+  std::stringstream CRC32string;
+  CRC32string << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << crc32;
+
+  if(no_of_entries < expected_entries){
+    std::cout << cache_path << " is corrupted (expected at least " << expected_entries << " entries, found " << no_of_entries << ")" << std::endl;
+    return false;
+  } else if (CRC32string.str() != cache_info[1]){
+    std::cout << cache_path << " is corrupted (CRC32 of entries is " << CRC32string.str() << ", expected " << cache_info[1] << ")" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 /*
  * Removes entries from cache if it dosen't match the DAT file
  *
@@ -214,40 +442,53 @@ cacheData getDataFromCache(std::string dat_path){
  *     dat_path : Path to DAT file
  */
 void updateCache(std::string dat_path){
-  std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
   std::string datfilename = std::get<1>(getCachePath(dat_path));
 
   cacheData cache_data = getDataFromCache(dat_path); // reading from cache
-  cache_data.info.erase(cache_data.info.begin(), cache_data.info.begin() + 4); // removes first 4 elements from cache_data.info (which are the strings from the first line of the cache)
-  cache_data.info[0] = datfilename; // update dat name
-
   datData dat_data = getDataFromDAT(dat_path); // reading from DAT
 
+  std::unordered_multimap<std::string, int> dat_index; // key is entryKey() of an entry in DAT, value is its index in dat_data
+  dat_index.reserve(dat_data.set_name.size());
+  for(int i = 0; i < dat_data.set_name.size(); i++){
+    dat_index.emplace(entryKey(dat_data.set_name[i], dat_data.rom_name[i]), i);
+  }
+
   // comparisons
-  std::vector<int> lines_to_keep;
-  lines_to_keep.push_back(1); // keep first line
-  lines_to_keep.push_back(3); // keep third line
+  cacheData updated_cache_data;
+  updated_cache_data.info = cache_data.info;
+  updated_cache_data.info[4] = datfilename; // update dat name
 
   for(int i = 0; i < cache_data.set_name.size(); i++){
-    for(int j = 0; j < dat_data.set_name.size(); j++){
+    auto range = dat_index.equal_range(entryKey(cache_data.set_name[i], cache_data.rom_name[i]));
+    for(auto it = range.first; it != range.second; ++it){
+      int j = it->second;
+      bool matches;
       if(cache_data.md5[i] == "-" && cache_data.sha1[i] == "-"){ // checks if md5 and sha1 are marked as ignored
-        if(cache_data.set_name[i] == dat_data.set_name[j] && cache_data.rom_name[i] == dat_data.rom_name[j] && cache_data.crc32[i] == dat_data.crc32[j]){ // if so, we only check set name, rom name, crc32
-          lines_to_keep.push_back(i+4);
-          break;
-        }
-      } else if (cache_data.set_name[i] == dat_data.set_name[j] && cache_data.rom_name[i] == dat_data.rom_name[j] && cache_data.crc32[i] == dat_data.crc32[j] && cache_data.md5[i] == dat_data.md5[j] && cache_data.sha1[i] == dat_data.sha1[j]){ // checks if set name, rom name, crc32, md5, sha1 match dat
-        lines_to_keep.push_back(i+4);
+        matches = cache_data.crc32[i] == dat_data.crc32[j]; // if so, we only check set name, rom name, crc32
+      } else {
+        matches = cache_data.crc32[i] == dat_data.crc32[j] && cache_data.md5[i] == dat_data.md5[j] && cache_data.sha1[i] == dat_data.sha1[j]; // checks if set name, rom name, crc32, md5, sha1 match dat
+      }
+
+      if(matches){ // keep entry
+        updated_cache_data.entry_index.emplace(entryKey(cache_data.set_name[i], cache_data.rom_name[i]), updated_cache_data.set_name.size());
+        updated_cache_data.set_name.push_back(cache_data.set_name[i]);
+        updated_cache_data.rom_name.push_back(cache_data.rom_name[i]);
+        updated_cache_data.crc32.push_back(cache_data.crc32[i]);
+        updated_cache_data.md5.push_back(cache_data.md5[i]);
+        updated_cache_data.sha1.push_back(cache_data.sha1[i]);
+        updated_cache_data.status.push_back(cache_data.status[i]);
+        updateSetCount(updated_cache_data, cache_data.set_name[i], cache_data.status[i], 1);
         break;
       }
     }
   }
 
   // updates cache file
-  onlyWriteCertainLines(cache_path.c_str(),lines_to_keep,cache_data.info);
+  writeCache(dat_path, updated_cache_data);
 }
 
 /*
- * Adds entries to cache. If there is an existing entry with the same set name and rom name, it will be removed.
+ * Adds entries to cache. If there is an existing entry with the same set name and rom name, it will be superseded by the new entry.
  *
  * Arguments:
  *     dat_path : Path to DAT file
@@ -255,78 +496,193 @@ void updateCache(std::string dat_path){
  * 
  * Returns:
  *     cache_data : Struct containing cache data
+ *
+ * Notes:
+ *     Entries are appended to the cache, leaving superseded entries in place (getDataFromCache() ignores them). Once too many lines are superseded (see needsCompaction()), the cache is compacted.
  */
 cacheData addToCache(std::string dat_path, std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> to_add_to_cache){
   std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
 
   cacheData cache_data = getDataFromCache(dat_path); // reading from cache
 
-  std::vector<int> lines_to_remove;
-  for(int i = 0; i < to_add_to_cache.size(); i++){
-    for(int j = 0; j < cache_data.set_name.size(); j++){
-      if(std::get<0>(to_add_to_cache[i]) == cache_data.set_name[j] && std::get<1>(to_add_to_cache[i]) == cache_data.rom_name[j]){
-        lines_to_remove.push_back(j+4);
-      }
-    }
-  }
-
-  if(lines_to_remove.size() > 0) {
-    removeLines(cache_path.c_str(),lines_to_remove); // removes existing entries with same set name and rom name
-    for(auto i: lines_to_remove){ // update cache_data by removing the element with index i-4
-      cache_data.set_name.erase(cache_data.set_name.begin() + i-4);
-      cache_data.rom_name.erase(cache_data.rom_name.begin() + i-4);
-      cache_data.crc32.erase(cache_data.crc32.begin() + i-4);
-      cache_data.md5.erase(cache_data.md5.begin() + i-4);
-      cache_data.sha1.erase(cache_data.sha1.begin() + i-4);
-      cache_data.status.erase(cache_data.status.begin() + i-4);
-    }
-  }
-  
   std::ofstream file(cache_path, std::ios_base::app); // open cache in append mode
   for(auto i: to_add_to_cache){
-    file << "\"" << std::get<0>(i) << "\" \"" << std::get<1>(i) << "\" \"" << std::get<2>(i) << "\" \"" << std::get<3>(i) << "\" \"" << std::get<4>(i) << "\" \"" << std::get<5>(i) << "\"" << std::endl; // writes entries to cache
+    file << formatEntry(std::get<0>(i), std::get<1>(i), std::get<2>(i), std::get<3>(i), std::get<4>(i), std::get<5>(i)); // writes entries to cache
 
     // updates cache_data
-    cache_data.set_name.push_back(std::get<0>(i));
-    cache_data.rom_name.push_back(std::get<1>(i));
-    cache_data.crc32.push_back(std::get<2>(i));
-    cache_data.md5.push_back(std::get<3>(i));
-    cache_data.sha1.push_back(std::get<4>(i));
-    cache_data.status.push_back(std::get<5>(i));
+    std::string key = entryKey(std::get<0>(i), std::get<1>(i));
+    auto it = cache_data.entry_index.find(key);
+    if(it == cache_data.entry_index.end()){ // new entry
+      cache_data.entry_index.emplace(std::move(key), cache_data.set_name.size());
+      cache_data.set_name.push_back(std::get<0>(i));
+      cache_data.rom_name.push_back(std::get<1>(i));
+      cache_data.crc32.push_back(std::get<2>(i));
+      cache_data.md5.push_back(std::get<3>(i));
+      cache_data.sha1.push_back(std::get<4>(i));
+      cache_data.status.push_back(std::get<5>(i));
+    } else { // supersedes existing entry with same set name and rom name
+      int j = it->second;
+      updateSetCount(cache_data, cache_data.set_name[j], cache_data.status[j], -1);
+      cache_data.crc32[j] = std::get<2>(i);
+      cache_data.md5[j] = std::get<3>(i);
+      cache_data.sha1[j] = std::get<4>(i);
+      cache_data.status[j] = std::get<5>(i);
+      cache_data.dead_rows++;
+    }
+    updateSetCount(cache_data, std::get<0>(i), std::get<5>(i), 1);
   }
   file.close();
+
+  if(needsCompaction(cache_data)){
+    writeCache(dat_path, cache_data);
+    std::cout << "Compacted " << cache_path << std::endl;
+  }
   
   return cache_data; 
 }
 
 /*
- * Gets missing entires in cache. If rom name and its corresponding set name in DAT is not in cache, it gets added to the vector to be returned.
+ * Makes a key that identifies an entry by its set name and rom name, for use in hashed lookups
  *
  * Arguments:
- *     dat_path : Path to DAT file
+ *     set_name : Set name of the entry
+ *     rom_name : Rom name of the entry
+ *
+ * Returns:
+ *     key : Set name and rom name joined by a null character (which can't appear in either name)
+ */
+std::string entryKey(std::string_view set_name, std::string_view rom_name){
+  std::string key;
+  key.reserve(set_name.size() + 1 + rom_name.size());
+  key.append(set_name);
+  key.push_back('\0');
+  key.append(rom_name);
+  return key;
+}
+
+/*
+ * Gets missing entires in cache. If the (set name, rom name) pair of an entry in DAT is not in cache, it gets added to the vector to be returned.
+ *
+ * Arguments:
+ *     dat_data : Struct containing DAT data (see definition in dat.h)
  *     cache_data : Cache data
  * 
  * Returns:
  *     toAddToCache : Vector containing tuples of strings. Each tuple consists of the set name, followed by rom name, CRC32, MD5, SHA1, status.
+ *
+ * Notes:
+ *     Done as a hashed set difference, so it is linear in the size of the DAT and cache
  */
-std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> getMissing(std::string dat_path, cacheData cache_data){
-  std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
+std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> getMissing(const datData &dat_data, const cacheData &cache_data){
+  std::unordered_set<std::string> added; // keys of entries added to toAddToCache, so an entry listed twice in DAT isn't added twice
+  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> toAddToCache; // set name, followed by rom name, CRC32, MD5, SHA1, status
 
-  pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_file(dat_path.c_str());
-  pugi::xml_node root = doc.child("datafile");
+  for(int i = 0; i < dat_data.set_name.size(); i++){
+    std::string key = entryKey(dat_data.set_name[i], dat_data.rom_name[i]);
+    if(cache_data.entry_index.count(key) == 0 && added.insert(key).second){ // (set name, rom name) pair is not in cache
+      toAddToCache.push_back(std::make_tuple(dat_data.set_name[i], dat_data.rom_name[i], dat_data.crc32[i], "-", "-", "Missing"));
+    }
+  }
 
-  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> toAddToCache; // set name, followed by rom name, CRC32, MD5, SHA1, status
+  return toAddToCache;
+}
+
+/*
+ * Gets path to the zip stats of a cache (sizes, modification times and central directory CRC32s of the set zips, as they were when the romset was last scanned)
+ *
+ * Arguments:
+ *     dat_path : Path to DAT file
+ *
+ * Returns:
+ *     stats_path : Path to zip stats (next to the cache, with ".stats" in place of ".cache")
+ */
+std::string getZipStatsPath(std::string dat_path){
+  std::string stats_path = std::get<0>(getCachePath(dat_path));
+  stats_path.replace(stats_path.size() - 6, 6, ".stats");
+  return stats_path;
+}
 
-  for(pugi::xml_node game = root.child("game"); game != nullptr; game = game.next_sibling()) {
-    for(pugi::xml_node rom = game.child("rom"); rom != nullptr; rom = rom.next_sibling()){
-      std::string rom_name = rom.attribute("name").value();
-      rom_name = fixName(rom_name);
-      if (!((std::find(cache_data.set_name.begin(), cache_data.set_name.end(), game.attribute("name").value()) != cache_data.set_name.end()) && (std::find(cache_data.rom_name.begin(), cache_data.rom_name.end(), rom_name) != cache_data.rom_name.end()))){ // if set name in DAT is not in cache_data.set_name and rom name in DAT is not in cache_data.rom_name
-      toAddToCache.push_back(std::make_tuple(game.attribute("name").value(), rom_name, rom.attribute("crc").value(), "-", "-", "Missing"));
+/*
+ * Gets size and modification time of a file
+ *
+ * Arguments:
+ *     path : Path to file
+ *
+ * Returns:
+ *     stat : Tuple containing size in bytes, modification time in nanoseconds; both are "-" if the file does not exist
+ */
+std::tuple<std::string, std::string> getFileStat(std::string path){
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0){
+    return std::make_tuple("-", "-");
+  }
+  long long mtime = (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  return std::make_tuple(std::to_string(st.st_size), std::to_string(mtime));
+}
+
+/*
+ * Gets zip stats of a cache, written by writeZipStats() at the end of the last scan
+ *
+ * Arguments:
+ *     dat_path : Path to DAT file
+ *
+ * Returns:
+ *     zip_stats : Map with key as set name, value as tuple containing size, modification time, central directory CRC32 of its zip; empty if there are no zip stats, or if the cache has been changed since they were written (e.g. by updating the DAT or compacting the cache)
+ */
+std::map<std::string, std::tuple<std::string, std::string, std::string>> getZipStats(std::string dat_path){
+  std::map<std::string, std::tuple<std::string, std::string, std::string>> zip_stats;
+  std::ifstream file(getZipStatsPath(dat_path));
+  std::string line;
+  std::string_view fields[4];
+  std::string scratch[4];
+  int line_no = 0;
+  bool up_to_date = false; // whether cache is the same as when zip stats were written
+
+  while(std::getline(file,line)){
+    line_no++;
+    const char *p = line.data();
+    const char *end = p + line.size();
+    int no_of_fields = 0;
+    while(no_of_fields < 4 && nextField(p, end, scratch[no_of_fields], fields[no_of_fields])){
+      no_of_fields++;
+    }
+
+    if(line_no == 1){ // first line of zip stats is info
+      continue;
+    } else if (line_no == 2){ // second line is size and modification time of cache when zip stats were written
+      std::tuple<std::string, std::string> cache_stat = getFileStat(std::get<0>(getCachePath(dat_path)));
+      up_to_date = no_of_fields == 2 && fields[0] == std::get<0>(cache_stat) && fields[1] == std::get<1>(cache_stat);
+      if(!(up_to_date)){
+        break;
       }
+    } else if (no_of_fields == 4){
+      zip_stats[std::string(fields[0])] = std::make_tuple(std::string(fields[1]), std::string(fields[2]), std::string(fields[3]));
     }
   }
 
-  return toAddToCache;
-}
\ No newline at end of file
+  if(!(up_to_date)){
+    zip_stats.clear();
+  }
+  return zip_stats;
+}
+
+/*
+ * Writes zip stats of a cache. Has to be called after the cache is written, as the cache's size and modification time are recorded so getZipStats() can tell if the cache was changed afterwards.
+ *
+ * Arguments:
+ *     dat_path : Path to DAT file
+ *     zip_stats : Map with key as set name, value as tuple containing size, modification time, central directory CRC32 of its zip
+ */
+void writeZipStats(std::string dat_path, const std::map<std::string, std::tuple<std::string, std::string, std::string>> &zip_stats){
+  std::string stats_path = getZipStatsPath(dat_path);
+  std::tuple<std::string, std::string> cache_stat = getFileStat(std::get<0>(getCachePath(dat_path)));
+
+  std::ofstream file(stats_path + ".tmp");
+  file << "romorganizer stats version 1.0" << "\n";
+  file << std::quoted(std::get<0>(cache_stat)) << " " << std::quoted(std::get<1>(cache_stat)) << "\n";
+  for(auto &i: zip_stats){
+    file << std::quoted(i.first) << " " << std::quoted(std::get<0>(i.second)) << " " << std::quoted(std::get<1>(i.second)) << " " << std::quoted(std::get<2>(i.second)) << "\n";
+  }
+  file.close();
+  rename((stats_path + ".tmp").c_str(), stats_path.c_str());
+}
@@ -0,0 +1,400 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <sys/stat.h>
+
+#include <dir2dat.h>
+#include <gethashes.h>
+#include <cache.h>
+#include <zipedit.h>
+#include "../include/archive.h"
+#include <container.h>
+
+namespace filesys = std::filesystem;
+
+/*
+ * Gets the containers of all sets in a romset folder
+ *
+ * Arguments:
+ *     folder_path : Path to the romset (*Path must end with a forward slash)
+ *     print_ignored (Optional) : Whether to print containers that are ignored
+ *
+ * Returns:
+ *     containers : Map with key as set name, value as its container (see definition of setContainer in container.h)
+ *
+ * Notes:
+ *     Only the top level of the folder is looked at. Set name is the name of a zip/7z or file without its extension, or the name of a directory.
+ *     If a set has more than one container (e.g. Set.zip and Set/), the first of zip, 7z, directory, file is used and the rest are ignored
+ *     Files and directories ending in .new or .tmp are left out, as they are written while fixing sets
+ */
+std::map<std::string, setContainer> getSetContainers(std::string folder_path, bool print_ignored){
+  std::map<std::string, setContainer> containers;
+  std::map<std::string, int> priority = {{"zip", 0}, {"7z", 1}, {"dir", 2}, {"file", 3}};
+  std::error_code ec;
+
+  for(auto &i: filesys::directory_iterator(folder_path, ec)){
+    std::string name = i.path().filename().string();
+    std::string extension = i.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == ".new" || extension == ".tmp"){
+      continue;
+    }
+
+    std::string set_name;
+    setContainer container;
+    if(i.is_directory(ec)){
+      set_name = name;
+      container = {folder_path + name + "/", "dir"};
+    } else if (i.is_regular_file(ec)){
+      set_name = i.path().stem().string();
+      if(extension == ".zip"){
+        container = {folder_path + name, "zip"};
+      } else if (extension == ".7z"){
+        container = {folder_path + name, "7z"};
+      } else {
+        container = {folder_path + name, "file"};
+      }
+    } else {
+      continue;
+    }
+
+    auto it = containers.find(set_name);
+    if(it == containers.end()){
+      containers[set_name] = container;
+      continue;
+    }
+    if(priority[container.type] < priority[it->second.type] || (container.type == it->second.type && container.path < it->second.path)){ // directory iteration order is not sorted, so ties are broken by path
+      std::swap(container, it->second);
+    }
+    if(print_ignored){
+      std::cout << container.path << " is ignored, " << set_name << " is in " << it->second.path << std::endl;
+    }
+  }
+  return containers;
+}
+
+/*
+ * Gets the container of a set, or where a new zip would go if the set has none
+ *
+ * Arguments:
+ *     containers : Containers of the romset, as from getSetContainers()
+ *     folder_path : Path to the romset (*Path must end with a forward slash)
+ *     set_name : Name of set
+ *
+ * Returns:
+ *     container : Container of the set (see definition in container.h)
+ */
+setContainer getSetContainer(const std::map<std::string, setContainer> &containers, std::string folder_path, std::string set_name){
+  auto it = containers.find(set_name);
+  if(it != containers.end()){
+    return it->second;
+  }
+  return {folder_path + set_name + ".zip", "zip"};
+}
+
+/*
+ * Gets the path to a file of an uncompressed set
+ *
+ * Arguments:
+ *     container : Container of type "dir" or "file" (see definition in container.h)
+ *     name : Name of file in set
+ *
+ * Returns:
+ *     path : Path to the file on disk
+ */
+std::string getContainerFilePath(const setContainer &container, std::string name){
+  if(container.type == "file"){
+    return container.path;
+  }
+  return container.path + name;
+}
+
+/*
+ * Gets names of all files in a set's container (without reading their data)
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *
+ * Returns:
+ *     names : Vector containing names of files in the set; for zips, this includes directories and is empty if the zip can't be read by getZipEntryNames()
+ */
+std::vector<std::string> getContainerEntryNames(const setContainer &container){
+  std::vector<std::string> names;
+  if(container.type == "zip"){
+    names = getZipEntryNames(container.path);
+  } else if (container.type == "7z"){
+    for(auto &i: getInfoFrom7z(container.path)){
+      names.push_back(i.first);
+    }
+  } else if (container.type == "dir"){
+    for(auto i: getAllFilesInDir(container.path)){
+      names.push_back(i.substr(container.path.length()));
+    }
+  } else {
+    names.push_back(filesys::path(container.path).filename().string());
+  }
+  return names;
+}
+
+/*
+ * Gets info from a set's container
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *     sizes (Optional) : Map that size of each file is put in (see getInfoFromZip())
+ *
+ * Returns:
+ *     data : Map with key as file name and value as CRC32 (same format as getInfoFromZip())
+ *
+ * Notes:
+ *     CRC32s of zips and 7zs are read from their headers; files of uncompressed sets are read in full
+ */
+std::map<std::string, std::string> getContainerInfo(const setContainer &container, std::map<std::string, std::string> *sizes){
+  if(container.type == "zip"){
+    return getInfoFromZip(container.path, sizes);
+  } else if (container.type == "7z"){
+    return getInfoFrom7z(container.path, sizes);
+  }
+
+  std::map<std::string, std::string> data;
+  for(auto i: getContainerEntryNames(container)){
+    data[i] = getCRC32(getContainerFilePath(container, i));
+    if(sizes != nullptr){
+      std::error_code ec;
+      (*sizes)[i] = std::to_string(filesys::file_size(getContainerFilePath(container, i), ec));
+    }
+  }
+  return data;
+}
+
+/*
+ * Hashes files in a set's container, without extracting them
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *     start_offset, data, part, no_of_parts, names (Optional) : See hashArchive()
+ *
+ * Returns:
+ *     hashes : Same as hashArchive()
+ */
+std::map<std::string, std::vector<std::string>> hashContainer(const setContainer &container, int start_offset, std::vector<std::tuple<int, std::string>> data, int part, int no_of_parts, const std::set<std::string> &names){
+  if(container.type == "zip" || container.type == "7z"){
+    return hashArchive(container.path, start_offset, data, part, no_of_parts, names);
+  }
+
+  std::map<std::string, std::vector<std::string>> hashes;
+  std::vector<std::string> files = getContainerEntryNames(container);
+  for(int i = part; i < files.size(); i += no_of_parts){
+    if(!(names.empty()) && !(names.count(files[i]))){
+      continue;
+    }
+    std::ifstream file(getContainerFilePath(container, files[i]), std::ifstream::binary);
+    if(!(file)){
+      hashes[files[i]] = {};
+      continue;
+    }
+    hashState state;
+    initHashes(state, start_offset, data);
+    char buf[1024 * 64];
+    while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+      updateHashes(state, buf, file.gcount());
+    }
+    hashes[files[i]] = finishHashes(state);
+    hashes[files[i]].push_back(getRawCRC32(state));
+  }
+  return hashes;
+}
+
+/*
+ * Gets size and modification time of a set's container (used to tell whether it changed since the last scan)
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *
+ * Returns:
+ *     stat : Same as getFileStat(); for a directory, size is the total size of its files and modification time is the latest of its files and directories (so that renaming, adding or removing a file changes it)
+ */
+std::tuple<std::string, std::string> getContainerStat(const setContainer &container){
+  if(container.type != "dir"){
+    return getFileStat(container.path);
+  }
+
+  struct stat st;
+  if(stat(container.path.c_str(), &st) != 0){
+    return std::make_tuple("-", "-");
+  }
+  unsigned long long size = 0;
+  long long mtime = (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  std::error_code ec;
+  for(auto &i: filesys::recursive_directory_iterator(container.path, ec)){
+    if(stat(i.path().c_str(), &st) != 0){
+      continue;
+    }
+    if(S_ISREG(st.st_mode)){
+      size += st.st_size;
+    }
+    mtime = std::max(mtime, (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec);
+  }
+  return std::make_tuple(std::to_string(size), std::to_string(mtime));
+}
+
+/*
+ * Gets a CRC32 that changes whenever what is listed in a set's container changes (see getCentralDirCRC32())
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *
+ * Returns:
+ *     crc32 : For a zip, CRC32 of its central directory. For a 7z, CRC32 of its header (as in its signature header). "-" if there is none (uncompressed sets only have their stat), or if it could not be read
+ */
+std::string getContainerListingCRC32(const setContainer &container){
+  if(container.type == "zip"){
+    return getCentralDirCRC32(container.path);
+  } else if (container.type == "7z"){
+    std::ifstream file(container.path, std::ios::binary);
+    char signature_header[32];
+    if(!(file.read(signature_header, 32)) || std::string(signature_header, 6) != "7z\xBC\xAF\x27\x1C"){
+      return "-";
+    }
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%02X%02X%02X%02X", (unsigned char)signature_header[31], (unsigned char)signature_header[30], (unsigned char)signature_header[29], (unsigned char)signature_header[28]);
+    return hex;
+  }
+  return "-";
+}
+
+/*
+ * Puts all files of a set's container in a workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     container : Container (see definition in container.h)
+ *
+ * Returns:
+ *     true if the container was read, false if not
+ *
+ * Notes:
+ *     Zips and 7zs are extracted (see extractToWorkspace()); files of uncompressed sets are copied
+ */
+bool loadContainer(workspace &ws, const setContainer &container){
+  if(container.type == "zip" || container.type == "7z"){
+    return extractToWorkspace(ws, container.path);
+  }
+  bool ok = true;
+  for(auto i: getContainerEntryNames(container)){
+    ok = addFileToWorkspace(ws, getContainerFilePath(container, i), i, true) && ok;
+  }
+  return ok;
+}
+
+/*
+ * Writes all files in a workspace as a set's container, and empties the workspace
+ *
+ * Arguments:
+ *     container : Container to write (see definition in container.h); any file or directory at its path is replaced
+ *     ws : Workspace (see definition in workspace.h)
+ *     scratch_dir : Directory that files are written to if they have to be zipped from disk (*Path must end with a forward slash)
+ *
+ * Returns:
+ *     true if the container was written, false if not (a "file" container can only hold one file)
+ */
+bool writeContainer(const setContainer &container, workspace &ws, std::string scratch_dir){
+  if(container.type == "zip"){
+    bool written = writeWorkspaceZip(container.path, ws);
+    if(!(written)){ // zip64 is needed
+      writeWorkspaceToDir(ws, scratch_dir);
+      std::vector<std::string> files_to_zip = getAllFilesInDir(scratch_dir);
+      write_zip(container.path,files_to_zip,scratch_dir,"2");
+      filesys::remove_all(scratch_dir);
+    }
+    clearWorkspace(ws);
+    return true;
+  } else if (container.type == "7z"){
+    writeWorkspaceToDir(ws, scratch_dir);
+    std::vector<std::string> files_to_zip = getAllFilesInDir(scratch_dir);
+    write_7z(container.path,files_to_zip,scratch_dir,"2");
+    filesys::remove_all(scratch_dir);
+    return true;
+  } else if (container.type == "dir"){
+    if(filesys::exists(container.path)){
+      filesys::remove_all(container.path);
+    }
+    filesys::create_directories(container.path);
+    writeWorkspaceToDir(ws, container.path);
+    return true;
+  }
+
+  if(ws.entries.size() != 1){
+    return false;
+  }
+  return writeFromWorkspace(ws, ws.entries.begin()->first, container.path);
+}
+
+/*
+ * Adds files on disk to a set's container. The container is created if it does not exist.
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ *     filenames : Vector containing strings of file paths; the files are moved into the container
+ *     rootfolder : Root folder of file paths (*path must end with a forward slash); names in the set are file paths relative to it
+ *     scratch_dir : Directory that can be used while adding (*Path must end with a forward slash); it is removed afterwards
+ *     sorted (Optional) : true to keep entries of a zip in order of name (see addToZip()); zips written from extracted files always are
+ *
+ * Notes:
+ *     If a file has the same name as a file already in the set, the one in the set is kept (as addToZip())
+ *     All files for a set should be added in one call, so the set is only written once
+ *     A "file" container becomes a directory named as the set, since it can only hold one file
+ */
+bool addFilesToContainer(const setContainer &container, std::vector<std::string> filenames, std::string rootfolder, std::string scratch_dir, bool sorted){
+  if(container.type == "zip" && addToZip(container.path,filenames,rootfolder,"2",sorted)){ // entries already in the set's zip are copied as is, only the new files get compressed
+    return true;
+  }
+
+  if(container.type == "zip" || container.type == "7z"){ // zip could not be edited (e.g. it is corrupted), or 7z (its entries can't be copied as they are): files in the set are extracted once and written with the new files to a new file, which replaces the set once it is written
+    workspace ws;
+    initWorkspace(ws, scratch_dir + "ws/");
+    for(auto i: filenames){
+      addFileToWorkspace(ws, i, i.substr(rootfolder.length()));
+    }
+    if(filesys::exists(container.path)){
+      extractToWorkspace(ws, container.path); // files already in the set replace new ones with the same name
+    }
+    bool written = writeContainer({container.path + ".new", container.type}, ws, scratch_dir + "write/");
+    if(written){
+      filesys::rename(container.path + ".new", container.path);
+    }
+    filesys::remove_all(scratch_dir);
+    return written;
+  }
+
+  std::string dir = container.path;
+  if(container.type == "file"){ // becomes a directory
+    filesys::path path = container.path;
+    dir = path.parent_path().string() + "/" + path.stem().string() + "/";
+    filesys::create_directories(dir);
+    moveFile(container.path, dir + path.filename().string());
+  }
+  for(auto i: filenames){
+    std::string destination = dir + i.substr(rootfolder.length());
+    if(filesys::exists(destination)){
+      continue;
+    }
+    filesys::create_directories(filesys::path(destination).parent_path());
+    moveFile(i, destination);
+  }
+  return true;
+}
+
+/*
+ * Removes a set's container (if it exists)
+ *
+ * Arguments:
+ *     container : Container (see definition in container.h)
+ */
+void removeContainer(const setContainer &container){
+  if(filesys::exists(container.path)){
+    filesys::remove_all(container.path);
+  }
+}
@@ -6,146 +6,160 @@
 #include <filesystem>
 #include <sys/stat.h>
 
-#include <openssl/md5.h>
-#include <openssl/sha.h>
-
 #include <gethashes.h>
 
 namespace filesys = std::filesystem;
 
 /*
- * Calculates CRC32, MD5 and SHA1 of a file, optionally skipping first X bytes before calculating hashes if certain criteria are met.
+ * Updates a CRC32 with more bytes
  *
  * Arguments:
- *     path : Path to a file
- *     start_offset (Optional) : Offset to start calculating hash from (in decimal)
- *     data (Optional) : Vector of tuples containing offset (in decimal) and their expected values (in lowercase); if all values at offsets of file matches expected values, hash is calculated from start_offset to the end of the file. If not, hash is calculated over the entire file.
+ *     crc32 : CRC32 so far (0xFFFFFFFF to start with)
+ *     buf : Bytes
+ *     len : Number of bytes
  *
  * Returns:
- *     output : Vector containing file size, CRC32, MD5, SHA1 of the file (in that order)
+ *     crc32 : Updated CRC32 (to be XORed with 0xFFFFFFFF once all bytes are in)
  *
  * Notes:
  *     CRC32 function taken from: https://blog.csdn.net/xiaobin_HLJ80/article/details/19500207
- *     MD5 function taken from: https://stackoverflow.com/a/42958050
- *     SHA1 function is a slight modification of the MD5 function.
- *     Getting hex from file: Partially taken from https://stackoverflow.com/questions/29238697/char-hex-because-it-shows-ffffff#comment46683759_29238733
- *
- * E.g. for Atari 7800:
- * std::vector<std::tuple<int, std::string>> data;
- * data.push_back(std::make_tuple(1,"415441524937383030"));
- * data.push_back(std::make_tuple(96,"0000000041435455414c20434152542044415441205354415254532048455245"));
- * std::vector<std::string> output = getHashes("Asteroids (USA).a78",128,data);
  */
-std::vector<std::string> getHashes(std::string path, int start_offset, std::vector<std::tuple<int, std::string>> data) {
-  // checks
-  if(!(filesys::exists(path))){
-    std::cout << path << " does not exist!" << std::endl;
-    exit(0);
-  }
-
-  std::ifstream file(path, std::ifstream::binary);
-
-  // get file size
-  std::uintmax_t filesize = filesys::file_size(path);
-
-  // generate CRC32 table
-  unsigned int crc32table[256];
-  unsigned int crc;
-  for(int i = 0; i < 256; i++) {
-    crc = i;
-    for(int j = 0; j < 8; j++) {
-      if((crc & 1) == 1) {
-          crc = (crc >> 1) ^ 0xEDB88320;
-      } else {
-          crc >>= 1;
+unsigned int updateCRC32(unsigned int crc32, const char *buf, size_t len){
+  static const std::vector<unsigned int> crc32table = [](){ // generated once
+    std::vector<unsigned int> table(256);
+    unsigned int crc;
+    for(int i = 0; i < 256; i++) {
+      crc = i;
+      for(int j = 0; j < 8; j++) {
+        if((crc & 1) == 1) {
+            crc = (crc >> 1) ^ 0xEDB88320;
+        } else {
+            crc >>= 1;
+        }
       }
+      table[i] = crc;
     }
-    crc32table[i] = crc;
+    return table;
+  }();
+
+  for(size_t i = 0; i < len; i++) {
+    crc32 = (crc32 >> 8) ^ crc32table[(crc32 ^ buf[i]) & 0xFF];
   }
+  return crc32;
+}
 
-  // call MD5_Init/SHA1_Init once
-  MD5_CTX md5Context;
-  MD5_Init(&md5Context);
-  SHA_CTX sha1Context;
-  SHA1_Init(&sha1Context);
+/*
+ * Starts hashing a file whose bytes are passed in with updateHashes(), e.g. as they are decompressed from an archive
+ *
+ * Arguments:
+ *     state : Struct containing hashing state (see definition in gethashes.h)
+ *     start_offset (Optional) : Offset to start calculating hash from (in decimal)
+ *     data (Optional) : Vector of tuples containing offset (in decimal) and their expected values (in lowercase); see getHashes()
+ */
+void initHashes(hashState &state, int start_offset, std::vector<std::tuple<int, std::string>> data){
+  state.size = 0;
+  state.crc32 = 0xFFFFFFFF;
+  state.raw_size = 0;
+  state.raw_crc32 = 0xFFFFFFFF;
+  MD5_Init(&state.md5);
+  SHA1_Init(&state.sha1);
+  state.start_offset = start_offset;
+  state.data = data;
+  state.head.clear();
+  state.head_size = start_offset > 0 ? start_offset : 0;
+  for(auto i: data){
+    state.head_size = std::max(state.head_size, (size_t)(std::get<0>(i) + std::get<1>(i).size()/2));
+  }
+  state.head_done = start_offset == -1 && data.size() == 0; // not skipping header
+}
 
-  char buf[1024 * 16]; // create buffer
-  char b[1024*16-start_offset]; // buf without header
-  int num_bytes_read = 0; // number of bytes read
-  std::vector<bool> checked; // vector of bools of whether each <data> matches
-  bool skipping_header_on_this_run = false; // whether we are skipping header on this chunk of buffer
-  bool skipped_header = false; // whether the header has been skipped
-
-  unsigned int crc32 = 0xFFFFFFFF;
-  while (file.good()) {
-    file.read(buf, sizeof(buf)); // read file in chunks into buffer
-
-    if(start_offset == -1 && data.size() == 0) { // not skipping header
-      skipping_header_on_this_run = false;
-    } else {
-      num_bytes_read += file.gcount();
-      for(int i = 0; i < data.size(); i++){
-        if(i == 0 && checked.size() == 0 || checked.size() == i && num_bytes_read >= std::get<0>(data[i])){ // if (its the first time we're running the code or checked[i] dosen't exist) and number of bytes read >= data offset
-          std::string to_check = "";
-          for(int j = std::get<0>(data[i]); j < std::get<0>(data[i]) + std::get<1>(data[i]).size()/2; j++){ // e.g. std::get<0>(data[i]) = 1, std::get<1>(data[i]) = "4e45" ⇒ we need to get bytes from offsets 1,2,3,4 ⇒ for(int j = 1, j < 5; j++) ⇒ 1 (std::get<0>(data[i])) + 4 (std::get<1>(data[i]).size()/2) = 5
-            std::stringstream ss;
-            ss << std::hex << std::setfill('0') << std::setw(2) << (unsigned int)(unsigned char)buf[j];
-            to_check += ss.str();
-          }
-
-          if(std::get<1>(data[i]) == to_check){ // if <data> matches
-            checked.push_back(true);
-          } else {
-            checked.push_back(false);
-          }
-        }
-      }
+/*
+ * Hashes bytes that come after the header (if any)
+ */
+void hashBytes(hashState &state, const char *buf, size_t len){
+  state.crc32 = updateCRC32(state.crc32, buf, len);
+  MD5_Update(&state.md5, buf, len);
+  SHA1_Update(&state.sha1, buf, len);
+  state.size += len;
+}
 
-      if(num_bytes_read >= start_offset && !(skipped_header)){
-        if (!(std::find(checked.begin(), checked.end(), false) != checked.end())){ // if "false" does not exist in checked (i.e. all of the rules are fufilled)
-          std::copy(buf + start_offset, std::end(buf), b); // copy (buf+start_offset to end of buf) to b
-          skipping_header_on_this_run = true;
-        }
-      }
+/*
+ * Works out whether the header is skipped from the bytes held back in head, then hashes them
+ */
+void hashHead(hashState &state){
+  bool skipping_header = state.start_offset != -1 && state.head.size() >= state.start_offset;
+  for(auto i: state.data){
+    int offset = std::get<0>(i);
+    std::string value = std::get<1>(i);
+    if(offset + value.size()/2 > state.head.size()){ // file is too small to have the header
+      skipping_header = false;
+      break;
     }
 
-    // calculate crc32
-    if(skipping_header_on_this_run){
-      for(int i = 0; i < file.gcount()-start_offset; i++) {
-        crc32 = (crc32 >> 8) ^ crc32table[(crc32 ^ b[i]) & 0xFF];
-      }
-    } else {
-      for(int i = 0; i < file.gcount(); i++) {
-        crc32 = (crc32 >> 8) ^ crc32table[(crc32 ^ buf[i]) & 0xFF];
-      }
+    std::stringstream to_check;
+    for(int j = offset; j < offset + value.size()/2; j++){
+      to_check << std::hex << std::setfill('0') << std::setw(2) << (unsigned int)(unsigned char)state.head[j];
     }
-
-    // call MD5_Update/SHA1_Update with each chunk of data you read from the file
-    if(skipping_header_on_this_run){
-      MD5_Update(&md5Context, b, file.gcount()-start_offset);
-      SHA1_Update(&sha1Context, b, file.gcount()-start_offset);
-    } else {
-      MD5_Update(&md5Context, buf, file.gcount());
-      SHA1_Update(&sha1Context, buf, file.gcount());
+    if(to_check.str() != value){ // <data> does not match
+      skipping_header = false;
+      break;
     }
+  }
+
+  size_t start = skipping_header ? state.start_offset : 0;
+  hashBytes(state, state.head.data() + start, state.head.size() - start);
+  state.head.clear();
+  state.head_done = true;
+}
+
+/*
+ * Hashes more bytes of a file
+ *
+ * Arguments:
+ *     state : Struct containing hashing state (see definition in gethashes.h), started with initHashes()
+ *     buf : Bytes
+ *     len : Number of bytes
+ */
+void updateHashes(hashState &state, const char *buf, size_t len){
+  state.raw_crc32 = updateCRC32(state.raw_crc32, buf, len);
+  state.raw_size += len;
 
-    if(skipping_header_on_this_run){
-      skipped_header = true;
-      skipping_header_on_this_run = false;
+  if(!(state.head_done)){
+    size_t n = std::min(len, state.head_size - state.head.size());
+    state.head.append(buf, n);
+    buf += n;
+    len -= n;
+    if(state.head.size() < state.head_size){
+      return;
     }
+    hashHead(state);
   }
+  hashBytes(state, buf, len);
+}
 
-  if(skipped_header){
-    filesize -= start_offset; // subtract skipped bytes from file size
+/*
+ * Finishes hashing a file
+ *
+ * Arguments:
+ *     state : Struct containing hashing state (see definition in gethashes.h)
+ *
+ * Returns:
+ *     output : Vector containing file size, CRC32, MD5, SHA1 of the file (in that order, same format as getHashes())
+ *
+ * Notes:
+ *     MD5 function taken from: https://stackoverflow.com/a/42958050
+ *     SHA1 function is a slight modification of the MD5 function.
+ */
+std::vector<std::string> finishHashes(hashState &state){
+  if(!(state.head_done)){ // file is smaller than head_size
+    hashHead(state);
   }
 
   // call MD5_Final/SHA1_Final once done to get the result
   unsigned char resultMD5[MD5_DIGEST_LENGTH];
   unsigned char resultSHA1[SHA_DIGEST_LENGTH];
-  MD5_Final(resultMD5, &md5Context);
-  SHA1_Final(resultSHA1, &sha1Context);
-
-  file.close();
+  MD5_Final(resultMD5, &state.md5);
+  SHA1_Final(resultSHA1, &state.sha1);
 
   // converting to string
   std::stringstream filesizestring;
@@ -153,9 +167,9 @@ std::vector<std::string> getHashes(std::string path, int start_offset, std::vect
   std::stringstream MD5string;
   std::stringstream SHA1string;
 
-  filesizestring << filesize;
+  filesizestring << state.size;
 
-  CRC32string << std::hex << (crc32 ^ ~0U);
+  CRC32string << std::hex << (state.crc32 ^ ~0U);
   std::string crc32sum = CRC32string.str();
 
   MD5string << std::hex << std::uppercase << std::setfill('0');
@@ -194,4 +208,122 @@ std::vector<std::string> getHashes(std::string path, int start_offset, std::vect
   output.push_back(md5sum);
   output.push_back(sha1sum);
   return output;
-}
\ No newline at end of file
+}
+
+/*
+ * Gets CRC32 of all bytes of a file (with header, if it is skipped)
+ *
+ * Arguments:
+ *     state : Struct containing hashing state (see definition in gethashes.h)
+ *
+ * Returns:
+ *     crc32 : CRC32 in the same format as getInfoFromZip() (i.e. as in a zip's central directory), so the two can be compared
+ */
+std::string getRawCRC32(const hashState &state){
+  if(state.raw_size == 0){
+    return "";
+  }
+  std::stringstream CRC32string;
+  CRC32string << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << (state.raw_crc32 ^ ~0U);
+  return CRC32string.str();
+}
+
+/*
+ * Calculates CRC32 of a file (faster than getHashes() when only CRC32 is needed, e.g. to list files of an uncompressed set)
+ *
+ * Arguments:
+ *     path : Path to a file
+ *
+ * Returns:
+ *     crc32 : CRC32 in the same format as getInfoFromZip() ("" if the file is empty), or "-" if the file could not be read
+ */
+std::string getCRC32(std::string path){
+  std::ifstream file(path, std::ifstream::binary);
+  if(!(file)){
+    return "-";
+  }
+  hashState state;
+  state.raw_size = 0;
+  state.raw_crc32 = 0xFFFFFFFF;
+  char buf[1024 * 64];
+  while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+    state.raw_crc32 = updateCRC32(state.raw_crc32, buf, file.gcount());
+    state.raw_size += file.gcount();
+  }
+  return getRawCRC32(state);
+}
+
+/*
+ * Calculates SHA1 of a file (faster than getHashes() when only SHA1 is needed, e.g. to tell whether two files with the same size and CRC32 are the same)
+ *
+ * Arguments:
+ *     path : Path to a file
+ *
+ * Returns:
+ *     sha1 : SHA1 in the same format as getHashes() ("" if the file is empty), or "-" if the file could not be read
+ */
+std::string getSHA1(std::string path){
+  std::ifstream file(path, std::ifstream::binary);
+  if(!(file)){
+    return "-";
+  }
+  SHA_CTX sha1;
+  SHA1_Init(&sha1);
+  unsigned long long size = 0;
+  char buf[1024 * 64];
+  while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+    SHA1_Update(&sha1, buf, file.gcount());
+    size += file.gcount();
+  }
+  if(size == 0){
+    return "";
+  }
+  unsigned char resultSHA1[SHA_DIGEST_LENGTH];
+  SHA1_Final(resultSHA1, &sha1);
+  std::stringstream SHA1string;
+  SHA1string << std::hex << std::uppercase << std::setfill('0');
+  for (const auto &byte: resultSHA1) {
+    SHA1string << std::setw(2) << (int)byte;
+  }
+  return SHA1string.str();
+}
+
+/*
+ * Calculates CRC32, MD5 and SHA1 of a file, optionally skipping first X bytes before calculating hashes if certain criteria are met.
+ *
+ * Arguments:
+ *     path : Path to a file
+ *     start_offset (Optional) : Offset to start calculating hash from (in decimal)
+ *     data (Optional) : Vector of tuples containing offset (in decimal) and their expected values (in lowercase); if all values at offsets of file matches expected values, hash is calculated from start_offset to the end of the file. If not, hash is calculated over the entire file.
+ *
+ * Returns:
+ *     output : Vector containing file size, CRC32, MD5, SHA1 of the file (in that order)
+ *
+ * Notes:
+ *     The file is read in chunks and passed to updateHashes(), the same as files hashed straight from an archive
+ *
+ * E.g. for Atari 7800:
+ * std::vector<std::tuple<int, std::string>> data;
+ * data.push_back(std::make_tuple(1,"415441524937383030"));
+ * data.push_back(std::make_tuple(96,"0000000041435455414c20434152542044415441205354415254532048455245"));
+ * std::vector<std::string> output = getHashes("Asteroids (USA).a78",128,data);
+ */
+std::vector<std::string> getHashes(std::string path, int start_offset, std::vector<std::tuple<int, std::string>> data) {
+  // checks
+  if(!(filesys::exists(path))){
+    std::cout << path << " does not exist!" << std::endl;
+    exit(0);
+  }
+
+  std::ifstream file(path, std::ifstream::binary);
+  hashState state;
+  initHashes(state, start_offset, data);
+
+  char buf[1024 * 16]; // create buffer
+  while (file.read(buf, sizeof(buf)) || file.gcount() > 0) { // read file in chunks into buffer
+    updateHashes(state, buf, file.gcount());
+  }
+  file.close();
+
+  return finishHashes(state);
+}
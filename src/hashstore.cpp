@@ -0,0 +1,205 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+#include <paths.h>
+#include <cache.h>
+#include <dat.h>
+#include <hashstore.h>
+#include <container.h>
+
+namespace filesys = std::filesystem;
+
+/*
+ * Gets path to the hash store
+ *
+ * Returns:
+ *     store_path : Path to the hash store (kept in the cache folder, next to the caches it is built from)
+ */
+std::string getHashStorePath(){
+  return cache_path + "romog.hashstore";
+}
+
+/*
+ * Makes a hash lowercase so the same hash from different DATs/caches is looked up under the same key
+ *
+ * Arguments:
+ *     hash : CRC32/SHA1 as a hex string
+ *
+ * Returns:
+ *     hash : Same hash in lowercase, or "-" if it is empty
+ */
+std::string normalizeHash(std::string hash){
+  if(hash.empty()){
+    return "-";
+  }
+  std::transform(hash.begin(), hash.end(), hash.begin(), ::tolower);
+  return hash;
+}
+
+/*
+ * Adds a row to the hash store
+ *
+ * Arguments:
+ *     store : Struct containing hash store data (see definition in hashstore.h)
+ *     sha1, crc32, size, dat_path, set_name, rom_name, location : Fields of the row
+ */
+void addRow(hashStore &store, std::string sha1, std::string crc32, std::string size, std::string dat_path, std::string set_name, std::string rom_name, std::string location){
+  sha1 = normalizeHash(sha1);
+  crc32 = normalizeHash(crc32);
+  if(size.empty()){
+    size = "-";
+  }
+
+  store.sha1.push_back(std::move(sha1));
+  store.crc32.push_back(std::move(crc32));
+  store.size.push_back(std::move(size));
+  store.dat_path.push_back(std::move(dat_path));
+  store.set_name.push_back(std::move(set_name));
+  store.rom_name.push_back(std::move(rom_name));
+  store.location.push_back(std::move(location));
+}
+
+/*
+ * Gets data from the hash store
+ *
+ * Returns:
+ *     store : Struct containing hash store data (see definition in hashstore.h); empty if the hash store has not been built yet
+ *
+ * Notes:
+ *     Each line after the first is a row with 7 quoted fields: sha1, crc32, size, DAT path, set name, rom name, location
+ */
+hashStore getHashStore(){
+  hashStore store;
+  std::ifstream file(getHashStorePath());
+  std::string line;
+  std::string_view fields[7];
+  std::string scratch[7];
+  int line_no = 0;
+
+  while(std::getline(file,line)){
+    line_no++;
+    if(line_no == 1){ // first line of hash store is info
+      continue;
+    }
+
+    const char *p = line.data();
+    const char *end = p + line.size();
+    int no_of_fields = 0;
+    while(no_of_fields < 7 && nextField(p, end, scratch[no_of_fields], fields[no_of_fields])){
+      no_of_fields++;
+    }
+    if(no_of_fields == 7){
+      addRow(store, std::string(fields[0]), std::string(fields[1]), std::string(fields[2]), std::string(fields[3]), std::string(fields[4]), std::string(fields[5]), std::string(fields[6]));
+    }
+  }
+
+  return store;
+}
+
+/*
+ * Writes the hash store to disk
+ *
+ * Arguments:
+ *     store : Struct containing hash store data (see definition in hashstore.h)
+ *
+ * Notes:
+ *     The hash store is written to a temporary file first, which then replaces the old one, so it is never left half-written
+ */
+void writeHashStore(hashStore &store){
+  std::string store_path = getHashStorePath();
+  std::ofstream file(store_path + ".tmp");
+  file << "romorganizer hashstore version 1.0" << "\n";
+  for(int i = 0; i < store.sha1.size(); i++){
+    file << std::quoted(store.sha1[i]) << " " << std::quoted(store.crc32[i]) << " " << std::quoted(store.size[i]) << " " << std::quoted(store.dat_path[i]) << " " << std::quoted(store.set_name[i]) << " " << std::quoted(store.rom_name[i]) << " " << std::quoted(store.location[i]) << "\n";
+  }
+  file.close();
+  filesys::rename(store_path + ".tmp", store_path);
+}
+
+/*
+ * Removes all rows of some DATs from the hash store
+ *
+ * Arguments:
+ *     store : Struct containing hash store data (see definition in hashstore.h)
+ *     dat_paths : Paths to DAT files
+ *
+ * Notes:
+ *     The store is gone through once however many DATs are removed, so DATs that are updated together should be removed together
+ */
+void removeFromHashStore(hashStore &store, const std::set<std::string> &dat_paths){
+  hashStore kept;
+  for(int i = 0; i < store.sha1.size(); i++){
+    if(!(dat_paths.count(store.dat_path[i]))){
+      addRow(kept, std::move(store.sha1[i]), std::move(store.crc32[i]), std::move(store.size[i]), std::move(store.dat_path[i]), std::move(store.set_name[i]), std::move(store.rom_name[i]), std::move(store.location[i]));
+    }
+  }
+  store = std::move(kept);
+}
+
+/*
+ * Adds rows for the entries of a DAT to the hash store, and where we have them according to its cache (the DAT's old rows have to be removed first, see removeFromHashStore())
+ *
+ * Arguments:
+ *     store : Struct containing hash store data (see definition in hashstore.h)
+ *     dat_path : Path to DAT file
+ *     folder_path : Path to the romset of the DAT (*Path must end with a forward slash)
+ *     dat_data : Struct containing DAT data (see definition in dat.h)
+ *     cache_data : Struct containing cache data (see definition in cache.h)
+ *
+ * Notes:
+ *     Cache entries mostly only have CRC32, so SHA1 and size are taken from the DAT; an entry is only "Passed" if its hashes match the DAT
+ */
+void addToHashStore(hashStore &store, std::string dat_path, std::string folder_path, const datData &dat_data, const cacheData &cache_data){
+  std::map<std::string, setContainer> containers = getSetContainers(folder_path);
+
+  for(int i = 0; i < dat_data.set_name.size(); i++){
+    std::string location = "-";
+    auto it = cache_data.entry_index.find(entryKey(dat_data.set_name[i], dat_data.rom_name[i]));
+    if(it != cache_data.entry_index.end() && cache_data.status[it->second] == "Passed"){
+      location = getSetContainer(containers, folder_path, dat_data.set_name[i]).path;
+    }
+    addRow(store, dat_data.sha1[i], dat_data.crc32[i], dat_data.size[i], dat_path, dat_data.set_name[i], dat_data.rom_name[i], location);
+  }
+}
+
+/*
+ * Replaces the rows of a DAT in the hash store with its current entries (see addToHashStore())
+ *
+ * Arguments:
+ *     store : Struct containing hash store data (see definition in hashstore.h)
+ *     dat_path : Path to DAT file
+ *     folder_path : Path to the romset of the DAT (*Path must end with a forward slash)
+ *     dat_data : Struct containing DAT data (see definition in dat.h)
+ *     cache_data : Struct containing cache data (see definition in cache.h)
+ */
+void updateHashStore(hashStore &store, std::string dat_path, std::string folder_path, const datData &dat_data, const cacheData &cache_data){
+  removeFromHashStore(store, {dat_path});
+  addToHashStore(store, dat_path, folder_path, dat_data, cache_data);
+}
+
+/*
+ * Replaces the rows of several DATs in the hash store with their current entries, from their DATs and caches, and writes the store once
+ *
+ * Arguments:
+ *     profiles : Vector of tuples containing DAT path and romset folder path (*Path must end with a forward slash) of each profile
+ *
+ * Notes:
+ *     Used after a batch of scans (see batchScan()), so the store is read and written once for the batch instead of once per DAT
+ */
+void refreshHashStore(const std::vector<std::tuple<std::string, std::string>> &profiles){
+  hashStore store = getHashStore();
+  std::set<std::string> dat_paths;
+  for(auto &i: profiles){
+    dat_paths.insert(std::get<0>(i));
+  }
+  removeFromHashStore(store, dat_paths);
+  for(auto &i: profiles){
+    addToHashStore(store, std::get<0>(i), std::get<1>(i), getDataFromDAT(std::get<0>(i)), getDataFromCache(std::get<0>(i)));
+  }
+  writeHashStore(store);
+}
@@ -17,6 +17,7 @@
 #include <dir2dat.h>
 #include <cache.h>
 #include <dat.h>
+#include <hashstore.h>
 #include <scanner.h>
 #include <rebuilder.h>
 #include <interface.h>
@@ -428,21 +429,24 @@ void unroll2(const YAML::Node & node) {
 }
 
 /*
- * Batch scans romsets by their DAT group, optionally rebuilding roms from rebuild path
- * 
+ * Gets the profiles of a DAT group
+ *
  * Arguments:
  *     dat_group : DAT group name
- *     to_rebuild (Optional) : true to rebuild roms from rebuild path
-*/
-void batchScan(std::string dat_group, bool toRebuild){
+ *
+ * Returns:
+ *     profiles : Vector of tuples containing DAT path and romset folder path (ending with a forward slash) of each profile in the DAT group
+ */
+std::vector<std::tuple<std::string, std::string>> getGroupProfiles(std::string dat_group){
   YAML::Node config = YAML::LoadFile(config_path);
   YAML::Node dats = config["dats"];
   YAML::Node datgrp = dats[dat_group];
   config_info.clear();
 
   unroll2(datgrp);
+  std::vector<std::string> dat_paths = getAllFilesInDir(dats_path);
+  std::vector<std::tuple<std::string, std::string>> profiles;
   for(auto i: config_info){
-    std::vector<std::string> dat_paths = getAllFilesInDir(dats_path);
     std::string dat_path;
     for(auto j: dat_paths){ // we have the filename of the DAT, but we need the full path
       if (j.find(std::get<0>(i)) != std::string::npos) {
@@ -455,15 +459,52 @@ void batchScan(std::string dat_group, bool toRebuild){
     if(folder_path.back() != '/'){ // if last character is not a forwardslash
       folder_path.push_back('/'); // add it
     }
+    profiles.push_back(std::make_tuple(dat_path, folder_path));
+  }
+  return profiles;
+}
 
-    scan(dat_path, folder_path);
+/*
+ * Batch scans romsets by their DAT group, optionally rebuilding roms from rebuild path
+ * 
+ * Arguments:
+ *     dat_group : DAT group name
+ *     to_rebuild (Optional) : true to rebuild roms from rebuild path
+ *     quick (Optional) : true to skip zips that have not changed since the last scan (see scan())
+ *
+ * Notes:
+ *     The hash store is updated once all romsets are scanned, instead of after each scan
+ *     Rebuilding is done once all romsets are scanned, for the whole DAT group at once (see rebuildGroup())
+*/
+void batchScan(std::string dat_group, bool toRebuild, bool quick){
+  std::vector<std::tuple<std::string, std::string>> profiles = getGroupProfiles(dat_group);
+  for(auto i: profiles){
+    scan(std::get<0>(i), std::get<1>(i), false, quick, false, {}, false);
+  }
+  refreshHashStore(profiles); // once for the whole batch
 
-    if(toRebuild){
-      rebuild(dat_path, folder_path, false); // false so rebuild folder won't get deleted
-    }
+  if(toRebuild){
+    rebuild(profiles, false); // false so rebuild folder won't get deleted
   }
 }
 
+/*
+ * Rebuilds roms from rebuild path to the romsets of a DAT group in one pass; each file is hashed once, and rebuilt to every profile that needs it (see rebuild())
+ *
+ * Arguments:
+ *     dat_group : DAT group name
+ *     toRemove : if true, files in rebuild folder that match a DAT will be removed; if false, the files will not be removed
+ *     sorted (Optional) : true to keep entries of zips in order of name (see rebuild())
+*/
+void rebuildGroup(std::string dat_group, bool toRemove, bool sorted){
+  std::vector<std::tuple<std::string, std::string>> profiles = getGroupProfiles(dat_group);
+  if(profiles.empty()){
+    std::cout << "DAT group " << dat_group << " has no profiles!" << std::endl;
+    exit(0);
+  }
+  rebuild(profiles, toRemove, sorted);
+}
+
 /*
  * Removes cache, optionally removes DAT, entry in config file and romset.
  * 
@@ -534,6 +575,97 @@ void deleteProfile(std::string dat_path, bool toRemoveEntry){
 
   filesys::remove(cache_path); // remove cache
   std::cout << "Removed " << cache_path << std::endl;
+  filesys::remove(getZipStatsPath(dat_path)); // remove zip stats of cache
+
+  if(filesys::exists(getHashStorePath())){ // remove DAT's rows from hash store
+    hashStore store = getHashStore();
+    removeFromHashStore(store, {dat_path});
+    writeHashStore(store);
+  }
+}
+
+/*
+ * Verifies a cache, then compacts it (rewrites it sorted by set name and rom name, without blank/superseded lines, and with a CRC32 of its entries). Set/rom count in cache is also recounted.
+ * 
+ * Arguments:
+ *     dat_path : Path to DAT
+*/
+void compactProfile(std::string dat_path){
+  std::tuple<std::string, std::string> cache_info = getCachePath(dat_path);
+  std::string cache_path = std::get<0>(cache_info);
+
+  // checks
+  if(!(filesys::exists(cache_path))){
+    std::cout << "Cache does not exist, please run scanner first (with -s | --scan) to create it." << std::endl;
+    exit(0);
+  }
+
+  bool intact = verifyCache(dat_path);
+  cacheData cache_data = getDataFromCache(dat_path, false); // don't exit if it's corrupted, so we can keep the entries that are left
+  int dead_rows = cache_data.dead_rows;
+
+  std::tuple<int, int, int, int> count = countSetsRoms(cache_data);
+  if(count != recountSetsRoms(cache_data)){ // should never happen
+    std::cout << "Set/rom count does not match entries in cache, recounting" << std::endl;
+    count = recountSetsRoms(cache_data);
+  }
+  cache_data.info.resize(10, "0");
+  cache_data.info[6] = std::to_string(std::get<0>(count));
+  cache_data.info[7] = std::to_string(std::get<1>(count));
+  cache_data.info[8] = std::to_string(std::get<2>(count));
+  cache_data.info[9] = std::to_string(std::get<3>(count));
+
+  writeCache(dat_path, cache_data);
+
+  std::cout << "Compacted " << cache_path << ": removed " << dead_rows << " blank/duplicate lines, " << cache_data.set_name.size() << " entries left" << std::endl;
+  if(!(intact)){
+    std::cout << "Cache was corrupted, scan the romset again (with -s | --scan) to restore lost entries" << std::endl;
+  }
+}
+
+/*
+ * Builds the hash store from scratch, from the DAT and cache of every profile in config file
+ *
+ * Notes:
+ *     scan() and rebuild() keep the hash store up to date afterwards; rebuilding it also drops rows of DATs that have since been updated or removed
+*/
+void buildHashStore(){
+  YAML::Node config = YAML::LoadFile(config_path);
+  YAML::Node dats = config["dats"];
+  config_info.clear();
+  unroll2(dats);
+
+  std::vector<std::string> dat_paths = getAllFilesInDir(dats_path);
+  hashStore store;
+  int dat_count = 0;
+
+  for(auto i: config_info){
+    std::string dat_path;
+    for(auto j: dat_paths){ // we have the filename of the DAT, but we need the full path
+      if (j.find(std::get<0>(i)) != std::string::npos) {
+        dat_path = j;
+        break;
+      }
+    }
+    if(dat_path.empty()){
+      continue;
+    }
+
+    std::string folder_path = std::get<1>(i);
+    if(folder_path.back() != '/'){ // if last character is not a forwardslash
+      folder_path.push_back('/'); // add it
+    }
+
+    datData dat_data = getDataFromDAT(dat_path);
+    cacheData cache_data = getDataFromCache(dat_path); // empty if romset has not been scanned, so all its roms are missing
+    addToHashStore(store, dat_path, folder_path, dat_data, cache_data); // store starts empty, so there are no old rows to remove
+    dat_count += 1;
+  }
+
+  writeHashStore(store);
+
+  int have = std::count_if(store.location.begin(), store.location.end(), [](const std::string &location){ return location != "-"; });
+  std::cout << "Built " << getHashStorePath() << " from " << dat_count << " DATs: " << store.sha1.size() << " roms wanted, " << have << " present" << std::endl;
 }
 
 /*
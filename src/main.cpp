@@ -18,6 +18,7 @@
 #include <scanner.h>
 #include <rebuilder.h>
 #include <fixdat.h>
+#include <watcher.h>
 
 namespace filesys = std::filesystem;
 
@@ -34,6 +35,7 @@ std::string dats_new_path;
 std::string fix_path;
 std::string headers_path;
 std::string rebuild_path;
+std::vector<std::string> rebuild_paths;
 std::string tmp_path;
 
 static const char USAGE[] =
@@ -46,13 +48,17 @@ R"(romorganizer by xprism
       romog (-d | --dir2dat) [ns | --nosort] <folder-path> <dat-path>
       romog (-g | --genconfig) [-a | --auto <dat-group> <base-path>]
       romog (-l | --list) [u]
-      romog (-s | --scan) <profile-no> ...
-      romog (-r | --rebuild) [nr | --noremove] <profile-no> ...
+      romog (-s | --scan) [-n | --dry-run] [-q | --quick] [-V | --verify] [-o | --ordered] <profile-no> ...
+      romog (-r | --rebuild) [nr | --noremove] [-o | --ordered] <profile-no> ...
+      romog (-R | --rebuild-group) [nr | --noremove] [-o | --ordered] <dat-group>
+      romog (-w | --watch) <profile-no> ...
       romog (-G | --genfixdat) <profile-no> ...
       romog (-L | --list-roms) [-C | --crc32] [-M | --md5] [-S | --sha1] [-p | --passed] [-m | --missing] <profile-no> ...
-      romog (-b | --batch-scan) [r] <dat-group>
+      romog (-b | --batch-scan) [-q | --quick] [r] <dat-group>
       romog (-u | --update-dats) [d]
       romog (-D | --delete) [-e | --entry] <profile-no> ...
+      romog (-c | --compact) <profile-no> ...
+      romog (-H | --hash-store)
 
     Options:
       -h --help             Show this screen.
@@ -65,8 +71,14 @@ R"(romorganizer by xprism
       -l --list             Lists DAT files with their profile number and set count.
       u                     Replace set count with latest DAT version from the DAT group's site.
       -s --scan             Scans romset(s).
+      -n --dry-run          Only shows what needs to be renamed/moved to backup folder, without changing anything.
+      -q --quick            Skips zips that have not changed since the last scan.
+      -V --verify           Decompresses every rom to check it against its zip and DAT (CRC32, MD5, SHA1); corrupted roms are moved to backup folder.
+      -o --ordered          Keeps entries of zips that are written in order of name (roms are only appended in place if they sort after the ones in the zip).
       -r --rebuild          Rebuilds roms to romset(s).
       nr --noremove         Disables removal of files in rebuild path that match DAT.
+      -R --rebuild-group    Rebuilds roms to all romsets of a DAT group at once; each file in rebuild path is only hashed once.
+      -w --watch            Watches romset(s) and rebuild path; rescans sets that change and rebuilds new files, until stopped with Ctrl+C.
       -G --genfixdat        Generates a fixDAT file based on the "Missing" entries in cache(s).
       -L --list-roms        Lists set names and rom names for a profile.
       -C --crc32            Shows CRC32 of roms.
@@ -75,11 +87,13 @@ R"(romorganizer by xprism
       -p --passed           Only show roms with "Passed" in cache.
       -m --missing          Only show roms with "Missing" in cache.
       -b --batch-scan       Batch scans roms of a DAT group.
-      r                     Runs the rebuilder after every set scanned.
+      r                     Runs the rebuilder (for the whole DAT group at once) after all romsets are scanned.
       -u --update-dats      Updates DATs in DAT folder.
       d                     Downloads new DATs from the links text file.
       -D --delete           Deletes cache(s).
       -e --entry            Deletes romset(s), DAT(s) and entry(s) in config file.
+      -c --compact          Verifies cache(s), then rewrites them sorted and without duplicate entries.
+      -H --hash-store       Builds the hash store (which roms every DAT wants and where we have them) from all DATs and caches.
 
 )";
 
@@ -130,56 +144,66 @@ int main(int argc, char* argv[]){
 
     for(auto it = paths.begin(); it != paths.end(); ++it){ // iterating through "paths:"
       std::string key = it->first.as<std::string>();
-      std::string value = it->second.as<std::string>();
+      std::vector<std::string> values; // rebuild can be a list of folders (e.g. on different disks) instead of one
+      if(it->second.IsSequence() && key == "rebuild"){
+        for(auto value: it->second){
+          values.push_back(value.as<std::string>());
+        }
+      } else {
+        values.push_back(it->second.as<std::string>());
+      }
       count += 1;
 
-      if(value == "Insert path here"){
-        std::cout << "Please replace \"Insert path here\" with the appropriate paths." << std::endl;
-        exit(0);
-      } else if (!(filesys::exists(value))){
-        std::cout << value << " does not exist, please create that file/directory." << std::endl;
-        exit(0);
-      } else { // get paths
-        if(count > 3){ // count > 3 means we are now at the paths to directories
-          if(value.back() != '/'){ // if last character is not a forwardslash
-            value.push_back('/'); // add it
+      for(auto value: values){
+        if(value == "Insert path here"){
+          std::cout << "Please replace \"Insert path here\" with the appropriate paths." << std::endl;
+          exit(0);
+        } else if (!(filesys::exists(value))){
+          std::cout << value << " does not exist, please create that file/directory." << std::endl;
+          exit(0);
+        } else { // get paths
+          if(count > 3){ // count > 3 means we are now at the paths to directories
+            if(value.back() != '/'){ // if last character is not a forwardslash
+              value.push_back('/'); // add it
+            }
           }
-        }
 
-        switch (count) {
-          case 1:
-            links_path = value;
-            break;
-          case 2:
-            sort_xsl_path = value;
-            break;
-          case 3:
-            www_path = value;
-            break;
-          case 4:
-            backup_path = value;
-            break;
-          case 5:
-            cache_path = value;
-            break;
-          case 6:
-            dats_path = value;
-            break;
-          case 7:
-            dats_new_path = value;
-            break;
-          case 8:
-            fix_path = value;
-            break;
-          case 9:
-            headers_path = value;
-            break;
-          case 10:
-            rebuild_path = value;
-            break;
-          case 11:
-            tmp_path = value;
-            break;
+          switch (count) {
+            case 1:
+              links_path = value;
+              break;
+            case 2:
+              sort_xsl_path = value;
+              break;
+            case 3:
+              www_path = value;
+              break;
+            case 4:
+              backup_path = value;
+              break;
+            case 5:
+              cache_path = value;
+              break;
+            case 6:
+              dats_path = value;
+              break;
+            case 7:
+              dats_new_path = value;
+              break;
+            case 8:
+              fix_path = value;
+              break;
+            case 9:
+              headers_path = value;
+              break;
+            case 10:
+              rebuild_paths.push_back(value);
+              rebuild_path = rebuild_paths[0];
+              break;
+            case 11:
+              tmp_path = value;
+              break;
+          }
         }
       }
     }
@@ -218,7 +242,7 @@ int main(int argc, char* argv[]){
         folder_path.push_back('/'); // add it
       }
 
-      scan(std::get<0>(paths),folder_path);
+      scan(std::get<0>(paths),folder_path,args["--dry-run"].asBool(),args["--quick"].asBool(),args["--verify"].asBool(),{},true,args["--ordered"].asBool());
     }
   } else if (args["--rebuild"].asBool()){
     std::vector<std::string> profile_nos = args["<profile-no>"].asStringList();
@@ -235,11 +259,26 @@ int main(int argc, char* argv[]){
       }
 
       if(toRemove){
-        rebuild(std::get<0>(paths),folder_path, true);
+        rebuild(std::get<0>(paths),folder_path, true, args["--ordered"].asBool());
       } else {
-        rebuild(std::get<0>(paths),folder_path, false);
+        rebuild(std::get<0>(paths),folder_path, false, args["--ordered"].asBool());
+      }
+    }
+  } else if (args["--rebuild-group"].asBool()){
+    rebuildGroup(args["<dat-group>"].asString(), !(args["nr"].asBool() || args["--noremove"].asBool()), args["--ordered"].asBool());
+  } else if (args["--watch"].asBool()){
+    std::vector<std::string> profile_nos = args["<profile-no>"].asStringList();
+    std::vector<std::tuple<std::string, std::string>> profiles;
+    for(auto i: profile_nos){
+      std::tuple<std::string, std::string> paths = getPaths(i);
+      std::string folder_path = std::get<1>(paths);
+      if(folder_path.back() != '/'){ // if last character is not a forwardslash
+        folder_path.push_back('/'); // add it
       }
+      profiles.push_back(std::make_tuple(std::get<0>(paths), folder_path));
     }
+
+    watch(profiles);
   } else if (args["--genfixdat"].asBool()){
     std::vector<std::string> profile_nos = args["<profile-no>"].asStringList();
     for(auto i: profile_nos){
@@ -316,10 +355,11 @@ int main(int argc, char* argv[]){
       }
     }
   } else if (args["--batch-scan"].asBool()){
-    if(argc == 3){
-      batchScan(args["<dat-group>"].asString());
-    } else if (args["r"].asBool() && argc == 4) {
-      batchScan(args["<dat-group>"].asString(), true);
+    bool quick = args["--quick"].asBool();
+    if(argc == 3 + quick){
+      batchScan(args["<dat-group>"].asString(), false, quick);
+    } else if (args["r"].asBool() && argc == 4 + quick) {
+      batchScan(args["<dat-group>"].asString(), true, quick);
     }
   } else if (args["--delete"].asBool()){
     std::vector<std::string> profile_nos = args["<profile-no>"].asStringList();
@@ -336,6 +376,14 @@ int main(int argc, char* argv[]){
         deleteProfile(std::get<0>(paths), false);
       }
     }
+  } else if (args["--compact"].asBool()){
+    std::vector<std::string> profile_nos = args["<profile-no>"].asStringList();
+    for(auto i: profile_nos){
+      std::tuple<std::string, std::string> paths = getPaths(i);
+      compactProfile(std::get<0>(paths));
+    }
+  } else if (args["--hash-store"].asBool()){
+    buildHashStore();
   } else if (args["--update-dats"].asBool()){
     if(args["d"].asBool()){
       updateDats(true);
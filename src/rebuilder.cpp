@@ -4,7 +4,13 @@
 #include <vector>
 #include <filesystem>
 #include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/stat.h>
 
 #include "../libs/termcolor/termcolor.hpp"
 
@@ -16,6 +22,10 @@
 #include "../include/archive.h"
 #include <scanner.h>
 #include <rebuilder.h>
+#include <zipedit.h>
+#include <container.h>
+#include <threadpool.h>
+#include <hashstore.h>
 
 namespace filesys = std::filesystem;
 
@@ -47,6 +57,21 @@ std::vector<std::string> listOfCompressedFiles(std::string path){
   return compressed_file_paths;
 }
 
+/*
+ * Checks whether a file is a zip/rar/7z (by its extension)
+ *
+ * Arguments:
+ *     path : Path to file
+ *
+ * Returns:
+ *     true if path ends with .zip, .rar or .7z (in any case), false otherwise
+ */
+bool isArchive(std::string path){
+  std::string extension = filesys::path(path).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension == ".zip" || extension == ".rar" || extension == ".7z";
+}
+
 /*
  * Recursively extracts files in path until there's no more compresed file left
  *
@@ -72,6 +97,156 @@ void recursiveExtractCompressedFiles(std::string path){
   }  
 }
 
+/*
+ * Lists files in all rebuild folders, with a queue of them for each disk they are on
+ *
+ * Arguments:
+ *     device_queues : Vector that the queues are put in; one per disk, each with indexes of files (in the vector returned) on that disk (see parallelForQueues())
+ *
+ * Returns:
+ *     files : Paths to files in rebuild folders (in the order of rebuild_paths); a file that is in more than one (e.g. one folder is in another) is only listed once
+ */
+std::vector<std::string> getRebuildFiles(std::vector<std::vector<int>> &device_queues){
+  std::vector<std::string> files;
+  std::map<dev_t, int> device_index; // key is device ID, value is index of its queue
+  std::set<std::string> listed; // canonical paths of files listed
+  for(auto root: rebuild_paths){
+    struct stat root_stat;
+    if(stat(root.c_str(), &root_stat) != 0){
+      continue;
+    }
+    int device = device_index.emplace(root_stat.st_dev, device_index.size()).first->second;
+    if(device == device_queues.size()){
+      device_queues.emplace_back();
+    }
+    for(auto i: getAllFilesInDir(root)){
+      if(!(listed.insert(filesys::weakly_canonical(i).string()).second)){
+        continue;
+      }
+      device_queues[device].push_back(files.size());
+      files.push_back(i);
+    }
+  }
+  return files;
+}
+
+/*
+ * Gets path to the rebuild journal
+ *
+ * Returns:
+ *     journal_path : Path to the rebuild journal
+ *
+ * Notes:
+ *     The journal is kept in tmp folder, with the files it describes; both are left there when tmp folder is cleared (see clearTmpFolder())
+ */
+std::string getRebuildJournalPath(){
+  return tmp_path + ".rebuild.journal";
+}
+
+/*
+ * Deletes what is in tmp folder, except what a rebuild that was stopped left in it: the rebuild journal and the folders of roms waiting to be added to their sets (see rebuild())
+ *
+ * Notes:
+ *     With toRemove, those roms were moved out of rebuild folder, so they may be the only copy; the next rebuild adds them to their sets, or moves them to recovered/ in rebuild folder
+ */
+void clearTmpFolder(){
+  filesys::create_directories(tmp_path);
+  std::vector<filesys::path> entries{filesys::directory_iterator(tmp_path), filesys::directory_iterator()}; // listed first, as they are removed
+  for(auto &i: entries){
+    std::string name = i.filename().string();
+    bool is_profile_dir = filesys::is_directory(i) && !(name.empty()) && std::all_of(name.begin(), name.end(), ::isdigit); // folder of a profile's sets (see tmpSetPath in rebuild())
+    if(is_profile_dir || i.string() == getRebuildJournalPath()){
+      continue;
+    }
+    filesys::remove_all(i);
+  }
+}
+
+/*
+ * Gets the first lines of a rebuild journal, which say which run it is for
+ *
+ * Arguments:
+ *     profiles : Vector of tuples containing DAT path and romset folder path of each profile (see rebuild())
+ *
+ * Returns:
+ *     header : Vector of lines; after the version line, one line per profile with DAT path, size and modification time of DAT, and romset folder path
+ */
+std::vector<std::string> getRebuildJournalHeader(const std::vector<std::tuple<std::string, std::string>> &profiles){
+  std::vector<std::string> header = {"romorganizer rebuild journal version 1.0"};
+  for(auto &i: profiles){
+    std::tuple<std::string, std::string> dat_stat = getFileStat(std::get<0>(i));
+    std::ostringstream line;
+    line << "P " << std::quoted(std::get<0>(i)) << " " << std::quoted(std::get<0>(dat_stat)) << " " << std::quoted(std::get<1>(dat_stat)) << " " << std::quoted(std::get<1>(i));
+    header.push_back(line.str());
+  }
+  return header;
+}
+
+/*
+ * Reads the rebuild journal left by a rebuild that was stopped (see rebuild())
+ *
+ * Arguments:
+ *     profiles : Vector of tuples containing DAT path and romset folder path of each profile (see rebuild())
+ *     journal : Rebuild journal (see definition in rebuilder.h) that what is read is put in
+ *
+ * Returns:
+ *     true if the journal exists and is for the same profiles and DATs (so indexes of DAT entries in it are still right), false if not
+ *
+ * Notes:
+ *     Each line ends with ".", so a line that was cut off (the run was stopped while writing it) is left out
+ */
+bool readRebuildJournal(const std::vector<std::tuple<std::string, std::string>> &profiles, rebuildJournal &journal){
+  std::ifstream file(getRebuildJournalPath());
+  if(!(file)){
+    return false;
+  }
+  std::string line;
+  for(auto &i: getRebuildJournalHeader(profiles)){
+    if(!(std::getline(file, line)) || line != i){
+      return false;
+    }
+  }
+
+  auto readRows = [](std::istringstream &in, std::vector<int> &rows){
+    int no_of_rows = 0;
+    in >> no_of_rows;
+    rows.resize(no_of_rows > 0 && in ? no_of_rows : 0);
+    for(auto &i: rows){
+      in >> i;
+    }
+  };
+  while(std::getline(file, line)){
+    std::istringstream in(line);
+    std::string type, end;
+    in >> type;
+    if(type == "H"){ // file was hashed: path, size, modification time, whether it is an archive, then the roms found in it
+      std::string path, size, mtime;
+      int archive = 0, no_of_matches = 0;
+      in >> std::quoted(path) >> std::quoted(size) >> std::quoted(mtime) >> archive >> no_of_matches;
+      std::vector<rebuildMatch> matches(no_of_matches > 0 && in ? no_of_matches : 0);
+      for(auto &i: matches){
+        int chain_length = 0;
+        in >> chain_length;
+        i.chain.resize(chain_length > 0 && in ? chain_length : 0);
+        for(auto &j: i.chain){
+          in >> std::quoted(j);
+        }
+        readRows(in, i.rows);
+      }
+      if(in >> end && end == "."){
+        journal.hashed[path] = std::make_tuple(size, mtime, archive, matches);
+      }
+    } else if(type == "C"){ // set was written: DAT entries added to it
+      std::vector<int> rows;
+      readRows(in, rows);
+      if(in >> end && end == "."){
+        journal.committed.insert(journal.committed.end(), rows.begin(), rows.end());
+      }
+    }
+  }
+  return true;
+}
+
 /*
  * Rebuilds files in rebuild folder that have CRC32, MD5, SHA1 in DAT to the romset. Also updates the entries in cache (if any). (*Scanner has to be run first to generate the cache)
  *
@@ -79,138 +254,634 @@ void recursiveExtractCompressedFiles(std::string path){
  *     dat_path : Path to DAT file
  *     folder_path : Path to folder to be scanned against the DAT file, i.e. path to the romset (*Path must end with a forward slash)
  *     toRemove : if true, files in rebuild folder that match DAT will be removed; if false, the files will not be removed
+ *     sorted (Optional) : true to keep entries of zips in order of name (see addFilesToContainer())
+*/
+void rebuild(std::string dat_path, std::string folder_path, bool toRemove, bool sorted){
+  rebuild({std::make_tuple(dat_path, folder_path)}, toRemove, sorted);
+}
+
+/*
+ * Rebuilds files in rebuild folders (see rebuild_paths in paths.h) to the romsets of several profiles at once; each file is hashed once, and rebuilt to every profile that needs it. Also updates the entries in caches (if any). (*Scanner has to be run first to generate the caches)
+ *
+ * Arguments:
+ *     profiles : Vector of tuples containing DAT path and romset folder path (*Path must end with a forward slash) of each profile
+ *     toRemove : if true, files in rebuild folders that match a DAT will be removed; if false, the files will not be removed
+ *     sorted (Optional) : true to keep entries of zips in order of name (see addFilesToContainer())
+ *
+ * Notes:
+ *     Entries of all DATs are put in one lookup, so files are matched against every DAT at the same time
+ *     zip/rar/7z files (and archives in them) are not extracted to the rebuild folder: files in them are hashed as they are decompressed, and only the ones that are rebuilt are extracted
+ *     Files are read by a pool of workers for each disk that rebuild folders are on (worker threads are split between disks), so every disk is kept busy and one slow disk doesn't hold up the others; each set is then written once, by one worker, with every file rebuilt to it
+ *     Files with the same size and CRC32 (e.g. the same dump in two rebuild folders) only have their SHA1 checked against the first one; if it is the same, the file is not hashed again or written to tmp dir
+ *     The hash store is updated for the profiles once the roms are in their sets (see hashstore.h)
+ *     A journal of files hashed and sets written is kept while rebuilding (see getRebuildJournalPath()). If a rebuild is stopped (e.g. it crashed), the next one for the same profiles does not hash those files again, and adds roms left in tmp dir to their sets; if the profiles are different, roms left in tmp dir are moved back to rebuild folder instead (to recovered/ in it), as are roms that could not be added to their sets
+ *     Files in recovered/ are only removed once they are rebuilt, even if toRemove is true
 */
-void rebuild(std::string dat_path, std::string folder_path, bool toRemove){
+void rebuild(std::vector<std::tuple<std::string, std::string>> profiles, bool toRemove, bool sorted){
   // checks
-  if(!(filesys::exists(dat_path))){
-    std::cout << dat_path << " does not exist!" << std::endl;
-    exit(0);
+  for(auto i: profiles){
+    std::string dat_path = std::get<0>(i);
+    if(!(filesys::exists(dat_path))){
+      std::cout << dat_path << " does not exist!" << std::endl;
+      exit(0);
+    }
+
+    if(!(filesys::is_directory(std::get<1>(i)))){
+      std::cout << std::get<1>(i) << " is not a directory!" << std::endl;
+      exit(0);
+    }
+
+    if(!(filesys::exists(std::get<0>(getCachePath(dat_path))))){ // getting path to cache from DAT path
+      std::cout << "Cache does not exist for " << dat_path << ", please run scanner first (with -s | --scan) to create it." << std::endl;
+      exit(0);
+    }
   }
 
-  if(!(filesys::is_directory(folder_path))){
-    std::cout << folder_path << " is not a directory!" << std::endl;
-    exit(0);
+  datData dat_data; // entries of all DATs, one after another
+  std::vector<int> dat_profile; // index of profile (in profiles) of each entry in dat_data
+  std::vector<int> dat_start; // index in dat_data of the first entry of each profile
+  std::vector<std::unordered_map<std::string, std::string>> set_status(profiles.size()); // for each profile, key is set name, value is status of its first entry in cache
+  for(int p = 0; p < profiles.size(); p++){
+    std::cout << "Rebuilding " << std::get<0>(profiles[p]) << std::endl;
+    datData profile_dat = getDataFromDAT(std::get<0>(profiles[p]));
+    dat_start.push_back(dat_data.sha1.size());
+    dat_data.set_name.insert(dat_data.set_name.end(), profile_dat.set_name.begin(), profile_dat.set_name.end());
+    dat_data.rom_name.insert(dat_data.rom_name.end(), profile_dat.rom_name.begin(), profile_dat.rom_name.end());
+    dat_data.crc32.insert(dat_data.crc32.end(), profile_dat.crc32.begin(), profile_dat.crc32.end());
+    dat_data.md5.insert(dat_data.md5.end(), profile_dat.md5.begin(), profile_dat.md5.end());
+    dat_data.sha1.insert(dat_data.sha1.end(), profile_dat.sha1.begin(), profile_dat.sha1.end());
+    dat_data.size.insert(dat_data.size.end(), profile_dat.size.begin(), profile_dat.size.end());
+    dat_profile.insert(dat_profile.end(), profile_dat.sha1.size(), p);
+
+    cacheData cache_data = getDataFromCache(std::get<0>(profiles[p]));
+    for(int k = 0; k < cache_data.set_name.size(); k++){
+      set_status[p].emplace(cache_data.set_name[k], cache_data.status[k]);
+    }
   }
+  std::vector<std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>>> toAddToCache(profiles.size()); // for each profile: set name, followed by rom name, CRC32, MD5, SHA1, status
+  std::set<std::tuple<int, std::string>> to_zip; // index of profile and name of set of folders in tmp/ to zip; set so duplicates won't get inserted
 
-  std::string cache_path = std::get<0>(getCachePath(dat_path)); // getting path to cache from DAT path
-  if(!(filesys::exists(cache_path))){
-    std::cout << "Cache does not exist, please run scanner first (with -s | --scan) to create it." << std::endl;
-    exit(0);
+  auto tmpSetPath = [&](int p, std::string set_name){ // folder in tmp dir that files of a set are put in; sets of different profiles can have the same name
+    return tmp_path + std::to_string(p) + "/" + set_name + "/";
+  };
+  auto tmpRomPath = [&](int j){ // path in tmp dir that DAT entry j is rebuilt to; we use the set name as other files in rebuild_path could belong to that set, so we'd want them moved there too
+    return tmpSetPath(dat_profile[j], dat_data.set_name[j]) + dat_data.rom_name[j];
+  };
+
+  // carrying on from a rebuild that was stopped
+  rebuildJournal journal;
+  bool resuming = readRebuildJournal(profiles, journal);
+  std::vector<int> staged; // DAT entries whose roms were left in tmp dir, and are whole
+  int recovered = 0; // number of roms left in tmp dir that were moved back to rebuild folder
+  std::string recovered_dir = rebuild_path + "recovered/"; // roms are moved here from tmp dir if they can't be added to their sets; what is in it is only deleted once it is rebuilt
+  auto recoverFile = [&](std::string path){ // moves a file in tmp dir to recovered_dir, keeping its path in tmp dir
+    std::string recovered_path = recovered_dir + path.substr(tmp_path.length());
+    filesys::create_directories(filesys::path(recovered_path).parent_path());
+    moveFile(path, recovered_path);
+  };
+  std::set<int> committed(journal.committed.begin(), journal.committed.end());
+  std::unordered_map<std::string, int> dat_by_tmp_path; // key is tmpRomPath() of entry in DAT, value is its index (only if there are roms left in tmp dir)
+  filesys::create_directories(tmp_path);
+  std::vector<filesys::path> tmp_entries{filesys::directory_iterator(tmp_path), filesys::directory_iterator()}; // listed first, as some are removed
+  for(auto &i: tmp_entries){
+    std::string name = i.filename().string();
+    if(name.rfind(".worker", 0) == 0){ // scratch dirs of workers
+      filesys::remove_all(i);
+      continue;
+    }
+    if(!(filesys::is_directory(i)) || name.empty() || !(std::all_of(name.begin(), name.end(), ::isdigit))){ // not a folder of a profile's sets (see tmpSetPath())
+      continue;
+    }
+    std::vector<filesys::path> set_dirs{filesys::directory_iterator(i), filesys::directory_iterator()};
+    for(auto &j: set_dirs){
+      if(j.extension() == ".work"){ // scratch dirs of sets being written
+        filesys::remove_all(j);
+      }
+    }
+    for(auto j: getAllFilesInDir(i.string() + "/")){
+      if(!(resuming)){
+        recoverFile(j);
+        recovered++;
+        continue;
+      }
+      if(dat_by_tmp_path.empty()){
+        for(int k = 0; k < dat_data.sha1.size(); k++){
+          dat_by_tmp_path.emplace(tmpRomPath(k), k);
+        }
+      }
+      auto it = dat_by_tmp_path.find(j);
+      std::string crc32 = it == dat_by_tmp_path.end() ? "" : dat_data.crc32[it->second];
+      std::transform(crc32.begin(), crc32.end(), crc32.begin(), ::toupper);
+      if(it != dat_by_tmp_path.end() && committed.count(it->second)){ // set was written, but the rebuild was stopped before this copy was removed
+        filesys::remove(j);
+      } else if(it != dat_by_tmp_path.end() && std::to_string(filesys::file_size(j)) == dat_data.size[it->second] && (dat_data.size[it->second] == "0" || getCRC32(j) == crc32)){
+        staged.push_back(it->second);
+      } else { // was being written when the rebuild was stopped; it is written again from the file in rebuild folder
+        filesys::remove(j);
+      }
+    }
+    if(!(resuming)){
+      filesys::remove_all(i);
+    }
+  }
+  if(resuming){
+    std::cout << "Carrying on from a rebuild that was stopped (" << journal.hashed.size() << " file(s) hashed, " << staged.size() << " rom(s) in tmp dir, " << journal.committed.size() << " rom(s) added to sets)" << std::endl;
+  } else if(recovered > 0){
+    std::cout << "Moved " << recovered << " rom(s) left in tmp dir by a rebuild that was stopped to " << recovered_dir << std::endl;
   }
 
-  std::cout << "Rebuilding " << dat_path << std::endl;
+  std::mutex journal_mutex;
+  std::ofstream journal_file;
+  if(resuming){
+    journal_file.open(getRebuildJournalPath(), std::ios::app);
+  } else {
+    journal_file.open(getRebuildJournalPath());
+    for(auto &i: getRebuildJournalHeader(profiles)){
+      journal_file << i << "\n";
+    }
+    journal_file.flush();
+  }
+  auto writeJournal = [&](std::string line){ // each line is written out straight away, so it is there if the rebuild is stopped
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    journal_file << line << " ." << "\n";
+    journal_file.flush();
+  };
+  auto rowsToString = [](const std::vector<int> &rows){
+    std::string line = std::to_string(rows.size());
+    for(int i: rows){
+      line += " " + std::to_string(i);
+    }
+    return line;
+  };
 
-  // recursively extract files in rebuild_path until there's no more compressed file left
-  recursiveExtractCompressedFiles(rebuild_path);
-  std::cout << "Extracted all compressed archives (if any)" << std::endl;
-  
-  std::vector<std::string> files_in_path = getAllFilesInDir(rebuild_path);
-  datData dat_data = getDataFromDAT(dat_path);
-  cacheData cache_data = getDataFromCache(dat_path);
-  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> toAddToCache; // set name, followed by rom name, CRC32, MD5, SHA1, status
-  std::set<std::string> to_zip; // vector containing names of folders in tmp/ to zip; set so duplicates won't get inserted
+  std::vector<std::vector<int>> device_queues; // files to read on each disk
+  std::vector<std::string> files_in_path = getRebuildFiles(device_queues);
 
-  for(auto i: files_in_path){
-    std::vector<std::string> file_info = getHashes(i); // rebuilder has to check all 3 hashes: CRC32, MD5, SHA1
-    bool hashMatchInDAT = false;
-    bool sha1_is_duped = false;
-    std::string status;
+  // lookup, so each file only costs a few hash lookups instead of a pass over the DATs and caches
+  std::unordered_map<std::string, std::vector<int>> dat_by_sha1; // key is SHA1, value is indexes of entries in dat_data with that SHA1 (in the order they are in the DATs)
+  for(int j = 0; j < dat_data.sha1.size(); j++){
+    dat_by_sha1[dat_data.sha1[j]].push_back(j);
+  }
 
-    for(int j = 0; j < dat_data.sha1.size(); j++){
-      if(dat_data.crc32[j] == file_info[1] && dat_data.md5[j] == file_info[2] && dat_data.sha1[j] == file_info[3]){
+  // prefilter, so files that can't be in DAT are thrown out before their MD5 and SHA1 are calculated: size is checked first (from a stat call, or an archive's header), then CRC32 (from an archive's header, or by reading the file)
+  std::unordered_set<std::string> dat_sizes; // sizes (in decimal) of entries in DAT
+  std::unordered_set<std::string> dat_size_crc32; // size and CRC32 of entries in DAT, as "size/CRC32" (CRC32 in uppercase)
+  bool prefilter = true; // false if an entry in DAT has no size or CRC32, so files can only be matched by their hashes
+  for(int j = 0; j < dat_data.sha1.size(); j++){
+    if(dat_data.size[j].empty() || dat_data.crc32[j].empty()){
+      prefilter = false;
+      break;
+    }
+    std::string crc32 = dat_data.crc32[j];
+    std::transform(crc32.begin(), crc32.end(), crc32.begin(), ::toupper);
+    dat_sizes.insert(dat_data.size[j]);
+    dat_size_crc32.insert(dat_data.size[j] + "/" + crc32);
+  }
+  auto mightMatch = [&](const std::string &size, const std::string &crc32){ // crc32 is in the format of getInfoFromZip(), or "-" to only check size
+    if(!(prefilter)){
+      return true;
+    }
+    if(!(dat_sizes.count(size))){
+      return false;
+    }
+    return crc32 == "-" || size == "0" || dat_size_crc32.count(size + "/" + crc32) > 0; // CRC32 of a blank file is "" in getInfoFromZip()'s format, so only its size is checked
+  };
+
+  // finds where a file goes: returns whether its CRC32, MD5, SHA1 are in DAT; rows gets the DAT entries it can be rebuilt to (none if those sets are already in romset)
+  auto matchFile = [&](const std::vector<std::string> &file_info, std::vector<int> &rows){
+    auto found = dat_by_sha1.find(file_info[3]);
+    if(found == dat_by_sha1.end()){ // SHA1 not in DAT
+      return false;
+    }
+    bool hashMatchInDAT = false;
+    for(int j: found->second){
+      if(dat_data.crc32[j] == file_info[1] && dat_data.md5[j] == file_info[2]){
         hashMatchInDAT = true;
+        auto it = set_status[dat_profile[j]].find(dat_data.set_name[j]);
+        if(it == set_status[dat_profile[j]].end() || it->second != "Passed"){ // not already in romset
+          rows.push_back(j);
+        }
+        if(found->second.size() == 1){ // can only stop at the first match if SHA1 is not duplicated in DATs
+          break;
+        }
+      }
+    }
+    return hashMatchInDAT;
+  };
+
+  std::mutex print_mutex;
+  auto print = [&](std::string line){ // files are rebuilt by several workers at once
+    std::lock_guard<std::mutex> lock(print_mutex);
+    std::cout << line << std::endl;
+  };
 
-        if (std::find(dat_data.sha1_dupes.begin(), dat_data.sha1_dupes.end(), file_info[3]) != dat_data.sha1_dupes.end()){
-          sha1_is_duped = true;
+  // finds files in an archive (and archives in it) that are in DAT without extracting the whole archive: each file is hashed as it is decompressed
+  // shown_path is how path is printed, chain is names of archives that path is in (see rebuildMatch), scratch_dir is where archives in it are extracted to (*Path must end with a forward slash); returns false if path could not be read as an archive
+  std::function<bool(std::string, std::string, std::vector<std::string>, std::string, std::vector<rebuildMatch> &)> matchInArchive = [&](std::string path, std::string shown_path, std::vector<std::string> chain, std::string scratch_dir, std::vector<rebuildMatch> &matches) -> bool {
+    std::set<std::string> to_hash; // files in the archive whose size and CRC32 (from the archive's header) are in DAT, and archives; empty to hash every file
+    if(prefilter){
+      std::map<std::string, std::string> crc32s; // from header, so files are not decompressed
+      std::map<std::string, std::string> sizes;
+      std::string extension = filesys::path(path).extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+      if(extension == ".zip"){
+        crc32s = getInfoFromZip(path, &sizes);
+      } else if(extension == ".7z"){
+        bool header_read = false;
+        try {
+          header_read = readInfoFrom7z(path, crc32s, &sizes);
+        } catch (...) { // file in rebuild folder can be anything; a header that can't be read is the same as one that is not there
+          header_read = false;
+        }
+        if(!(header_read)){ // every file is hashed by hashArchive() instead, as decompressing does not rely on what the header says about files
+          crc32s.clear();
+          sizes.clear();
         }
+      }
+      for(auto &i: crc32s){
+        if(isArchive(i.first) || mightMatch(sizes[i.first], i.second)){
+          to_hash.insert(i.first);
+        }
+      }
+      if(!(crc32s.empty()) && to_hash.empty()){ // nothing in it can be in DAT
+        return true;
+      }
+    }
 
-        // getting status in cache
-        for(int k = 0; k < cache_data.set_name.size(); k++){
-          if(cache_data.set_name[k] == dat_data.set_name[j]){
-            status = cache_data.status[k];
-            break;
-          }
+    std::map<std::string, std::vector<std::string>> hashes = hashArchive(path, -1, {}, 0, 1, to_hash);
+    if(hashes.empty()){
+      return false;
+    }
+
+    std::set<std::string> nested; // archives in the archive; these are extracted and searched in turn
+    for(auto &i: hashes){
+      std::vector<std::string> file_chain = chain;
+      file_chain.push_back(i.first);
+      if(isArchive(i.first)){
+        nested.insert(i.first);
+        continue;
+      }
+      if(i.second.empty()){
+        print("Skipped " + shown_path + "/" + i.first + " (corrupted)");
+        continue;
+      }
+      std::vector<int> rows;
+      matchFile(i.second, rows);
+      if(!(rows.empty())){
+        matches.push_back({file_chain, rows});
+      }
+    }
+    if(nested.empty()){
+      return true;
+    }
+
+    workspace ws;
+    initWorkspace(ws, scratch_dir);
+    extractToWorkspace(ws, path, nested);
+    for(auto &i: nested){
+      if(!(ws.entries.count(i))){ // could not be extracted
+        continue;
+      }
+      std::vector<std::string> file_chain = chain;
+      file_chain.push_back(i);
+      std::string nested_path = scratch_dir + "nested/" + filesys::path(i).filename().string();
+      writeFromWorkspace(ws, i, nested_path);
+      if(!(matchInArchive(nested_path, shown_path + "/" + i, file_chain, scratch_dir + "nested/" + std::to_string(matches.size()) + "/", matches))){ // not an archive after all; e.g. a rom named .zip
+        std::vector<int> rows;
+        matchFile(getHashes(nested_path), rows);
+        if(!(rows.empty())){
+          matches.push_back({file_chain, rows});
         }
+      }
+      filesys::remove(nested_path);
+    }
+    clearWorkspace(ws);
+    filesys::remove_all(scratch_dir);
+    return true;
+  };
 
-        if(status == "Passed"){ // file is already in romset
-          filesys::remove(i); // remove file
-          std::cout << "Deleted " << i << " (already in romset)" << std::endl;
-        } else {
-          std::string correct_set_name = dat_data.set_name[j];
-          std::string correct_rom_name = dat_data.rom_name[j];
+  // extracts files found by matchInArchive() to where they are rebuilt; wanted has key as chain of file (without archives above path), value as DAT entries it is rebuilt to
+  // written gets the DAT entries that were written
+  std::function<void(std::string, std::string, const std::map<std::vector<std::string>, std::vector<int>> &, std::string, std::vector<int> &)> placeFromArchive = [&](std::string path, std::string shown_path, const std::map<std::vector<std::string>, std::vector<int>> &wanted, std::string scratch_dir, std::vector<int> &written){
+    std::set<std::string> to_extract;
+    std::map<std::string, std::map<std::vector<std::string>, std::vector<int>>> nested; // key is archive in the archive, value is what is wanted from it
+    for(auto &i: wanted){
+      to_extract.insert(i.first[0]);
+      if(i.first.size() > 1){
+        nested[i.first[0]][std::vector<std::string>(i.first.begin() + 1, i.first.end())] = i.second;
+      }
+    }
 
-          std::string tmp_dir = tmp_path + correct_set_name + "/"; // we use correct_set_name as other files in rebuild_path could belong to that set; so we'd want it moved there
-          if(!(filesys::exists(tmp_dir))){
-            filesys::create_directory(tmp_dir); // create tmp dir if not present
+    workspace ws;
+    initWorkspace(ws, scratch_dir);
+    extractToWorkspace(ws, path, to_extract);
+    for(auto &i: wanted){
+      if(i.first.size() > 1 || !(ws.entries.count(i.first[0]))){ // could not be extracted
+        continue;
+      }
+      std::string first_path = "";
+      for(int j: i.second){
+        if(first_path == ""){
+          if(!(writeFromWorkspace(ws, i.first[0], tmpRomPath(j)))){
+            break;
           }
+          first_path = tmpRomPath(j);
+        } else {
+          cloneFile(first_path, tmpRomPath(j));
+        }
+        print("Renamed " + shown_path + "/" + i.first[0] + " to " + dat_data.rom_name[j]);
+        written.push_back(j);
+      }
+    }
+    for(auto &i: nested){
+      if(!(ws.entries.count(i.first))){
+        continue;
+      }
+      std::string nested_path = scratch_dir + "nested/" + filesys::path(i.first).filename().string();
+      writeFromWorkspace(ws, i.first, nested_path);
+      placeFromArchive(nested_path, shown_path + "/" + i.first, i.second, scratch_dir + "nested/" + std::to_string(written.size()) + "/", written);
+      filesys::remove(nested_path);
+    }
+    clearWorkspace(ws);
+    filesys::remove_all(scratch_dir);
+  };
 
-          if(correct_rom_name.find('/') != std::string::npos){ // if correct_rom_name has slash, make that directory structure in tmp dir (so that we can move the file to the correct directory)
-            filesys::path p = correct_rom_name;
-            std::string parentpath = p.parent_path(); // .parent_path(): gets parent path (eg: if correct_rom_name = "files/a.rom", parentpath = "files")
-            
-            if(!(filesys::exists(tmp_dir+parentpath))){
-              filesys::create_directories(tmp_dir+parentpath);
-            }
-          }
+  // rebuilding is split into steps, so files are hashed in parallel, and each set is written once by one worker:
+  // 1. files in rebuild folders are hashed and matched against DAT in parallel, with worker threads split between disks (files that can't be rebuilt are deleted); files that are not in an archive are hashed once per size and CRC32, others with the same size and CRC32 only have their SHA1 compared
+  // 2. each rom that is missing is given to the first file (in the order of files_in_path) that matches it, so no two files are written to the same path in tmp dir
+  // 3. files are written to tmp dir in parallel, with worker threads split between disks (each file's roms are different paths)
+  // 4. files in tmp dir are added to each set in parallel (one worker per set)
+  std::vector<std::vector<rebuildMatch>> files_matches(files_in_path.size()); // roms found in each file
+  std::vector<int> files_archive(files_in_path.size()); // whether file is an archive
+  std::vector<std::string> files_size_crc32(files_in_path.size()); // size and CRC32 ("size/CRC32") of files not in an archive that still have to be hashed
+  std::vector<std::tuple<std::string, std::string>> files_stat(files_in_path.size()); // size and modification time of each file, as journaled
+  auto journalHashed = [&](int job){
+    std::ostringstream line;
+    line << "H " << std::quoted(files_in_path[job]) << " " << std::quoted(std::get<0>(files_stat[job])) << " " << std::quoted(std::get<1>(files_stat[job])) << " " << files_archive[job] << " " << files_matches[job].size();
+    for(auto &j: files_matches[job]){
+      line << " " << j.chain.size();
+      for(auto &k: j.chain){
+        line << " " << std::quoted(k);
+      }
+      line << " " << rowsToString(j.rows);
+    }
+    writeJournal(line.str());
+  };
+  auto removeFile = [&](std::string path, std::string reason, bool in_romset){ // removes a file in a rebuild folder that is not rebuilt; files in recovered_dir are kept unless the rom is in its romset, as they may be its only copy
+    if(!(in_romset) && path.rfind(recovered_dir, 0) == 0){
+      print("Kept " + path + " " + reason);
+      return;
+    }
+    filesys::remove(path); // remove file
+    print("Deleted " + path + " " + reason);
+  };
+  auto matchLoose = [&](int job, const std::vector<std::string> &file_info){ // matches a file that is not in an archive from its hashes
+    std::string i = files_in_path[job];
+    std::vector<int> rows;
+    if(!(matchFile(file_info, rows))){ // CRC32, MD5, SHA1 not in DAT
+      removeFile(i, "(does not match DAT)", false);
+    } else if(rows.empty()){ // file is already in romset
+      removeFile(i, "(already in romset)", true);
+    } else {
+      files_matches[job].push_back({{}, rows});
+      journalHashed(job);
+    }
+  };
+  parallelForQueues(device_queues, [&](int job, int worker){
+    std::string i = files_in_path[job];
+    files_stat[job] = getFileStat(i);
+    auto hashed = journal.hashed.find(i);
+    if(hashed != journal.hashed.end() && std::get<0>(hashed->second) == std::get<0>(files_stat[job]) && std::get<1>(hashed->second) == std::get<1>(files_stat[job])){ // hashed by the rebuild that was stopped, and not changed since
+      files_archive[job] = std::get<2>(hashed->second);
+      files_matches[job] = std::get<3>(hashed->second);
+      return;
+    }
 
-          bool file_in_tmp_dir = false; // whether we moved/copied i to tmp_dir+correct_rom_name
-          if(toRemove && !(sha1_is_duped)){ // if SHA1 is duplicated in DAT, we can't move the rom since we have to rebuild it to other sets too
-            filesys::rename(i,tmp_dir+correct_rom_name); // rename file to correct name and move file to tmp dir
-            file_in_tmp_dir = true;
-          } else if (!(filesys::exists(tmp_dir+correct_rom_name))) { // if that path already exists, we don't copy it. e.g. set 1 has rom A and rom B, set 2 has rom C and rom D, rom A and rom C are identical (same CRC32, MD5, SHA1). after set 1 has been rebuilt, set 2's rom C would copy to set 1's rom A and error at filesys::copy_file since it already exists
-            filesys::copy_file(i,tmp_dir+correct_rom_name);
-            file_in_tmp_dir = true;
-          }
+    std::string scratch_dir = tmp_path + ".worker" + std::to_string(worker) + "/";
+    if(isArchive(i) && matchInArchive(i, i, {}, scratch_dir, files_matches[job])){
+      files_archive[job] = 1;
+      journalHashed(job);
+      return;
+    }
 
-          if(file_in_tmp_dir){
-            std::cout << "Renamed " << i << " to " << correct_rom_name << std::endl;
+    std::string size = std::to_string(filesys::file_size(i));
+    std::string crc32;
+    if(!(mightMatch(size, "-")) || !(mightMatch(size, crc32 = getCRC32(i)))){ // size or CRC32 not in DAT; CRC32 is only read if size is in DAT
+      removeFile(i, "(does not match DAT)", false);
+      return;
+    }
+    files_size_crc32[job] = size + "/" + crc32;
+  });
 
-            if(filesys::exists(folder_path+correct_set_name+".zip")){ // if existing file exists in romset
-              extract(folder_path+correct_set_name+".zip",tmp_dir); // extract file to tmp dir
-              filesys::remove(folder_path+correct_set_name+".zip"); // remove file
-            }
+  // files with the same size and CRC32 are most likely the same file (e.g. the same dump in two rebuild folders), so only the first is fully hashed; the others have their SHA1 compared to it
+  std::map<std::string, std::vector<int>> same_size_crc32; // key is size and CRC32, value is files with them (in the order of files_in_path)
+  for(int job = 0; job < files_in_path.size(); job++){
+    if(!(files_size_crc32[job].empty())){
+      same_size_crc32[files_size_crc32[job]].push_back(job);
+    }
+  }
+  std::vector<int> files_first(files_in_path.size(), -1); // first file with the same size and CRC32, for files that are not the first
+  for(auto &i: same_size_crc32){
+    for(int j = 1; j < i.second.size(); j++){
+      files_first[i.second[j]] = i.second[0];
+    }
+  }
+  std::vector<std::vector<std::string>> files_info(files_in_path.size()); // hashes of first files (see getHashes())
+  std::vector<std::string> files_sha1(files_in_path.size()); // SHA1 of files that are not the first
+  parallelForQueues(device_queues, [&](int job, int worker){
+    if(files_size_crc32[job].empty()){ // archive, hashed by the rebuild that was stopped, or deleted
+      return;
+    }
+    if(files_first[job] < 0){
+      files_info[job] = getHashes(files_in_path[job]); // rebuilder has to check all 3 hashes: CRC32, MD5, SHA1
+    } else {
+      files_sha1[job] = getSHA1(files_in_path[job]);
+    }
+  });
+  for(int job = 0; job < files_in_path.size(); job++){
+    if(files_size_crc32[job].empty()){
+      continue;
+    }
+    int first = files_first[job];
+    if(first < 0){
+      matchLoose(job, files_info[job]);
+    } else if(files_sha1[job] == files_info[first][3]){ // same file; its roms are given to the first one (see below), so it is not written again
+      std::string i = files_in_path[job];
+      if(toRemove || files_matches[first].empty()){
+        removeFile(i, "(same as " + files_in_path[first] + ")", !(files_matches[first].empty()));
+      } else {
+        print("Skipped " + i + " (same as " + files_in_path[first] + ")");
+      }
+    } else if(filesys::exists(files_in_path[job])){ // same size and CRC32, but a different file
+      matchLoose(job, getHashes(files_in_path[job]));
+    }
+  }
 
-            removeEmptyDirs(tmp_dir); // needed because e.g. if we move tmp_dir/a/Asteroids.a52 -> tmp_dir/files/Asteroids.a52 (correct location), we still need to get rid of the empty folder tmp_dir/a so it won't get zipped (if we move tmp_dir/files/AsteroidsWrongName.a52 -> tmp_dir/files/Asteroids.a52, then there's no need to remove any folder)
+  std::set<std::string> taken; // paths in tmp dir that a file has been given
+  for(int j: journal.committed){ // already added to its set by the rebuild that was stopped
+    taken.insert(tmpRomPath(j));
+  }
+  for(auto &i: files_matches){
+    for(auto &j: i){
+      std::vector<int> rows;
+      for(int k: j.rows){
+        std::string rom_path = tmpRomPath(k);
+        if(filesys::exists(rom_path) || !(taken.insert(rom_path).second)){ // we don't write to a path twice. e.g. set 1 has rom A and rom B, set 2 has rom C and rom D, rom A and rom C are identical (same CRC32, MD5, SHA1). after set 1 has been rebuilt, set 2's rom C would be written over set 1's rom A
+          continue;
+        }
+        filesys::create_directories(filesys::path(rom_path).parent_path()); // rom name can have slashes (eg: "files/a.rom"); made here so workers don't race to make them
+        rows.push_back(k);
+      }
+      j.rows = rows;
+    }
+  }
 
-            to_zip.insert(correct_set_name);
-            toAddToCache.push_back(std::make_tuple(correct_set_name, correct_rom_name, dat_data.crc32[j], dat_data.md5[j], dat_data.sha1[j], "Passed"));
+  std::vector<std::vector<int>> files_written(files_in_path.size()); // DAT entries each file was written to
+  parallelForQueues(device_queues, [&](int job, int worker){
+    std::string i = files_in_path[job];
+    if(!(files_archive[job])){
+      for(auto &j: files_matches[job]){
+        for(int k: j.rows){
+          if(k != j.rows[0]){ // e.g. SHA1 is duplicated in DAT; the rom is cloned from the first copy in tmp dir, so each one costs metadata only where the filesystem allows it
+            cloneFile(tmpRomPath(j.rows[0]), tmpRomPath(k));
+          } else if(toRemove){
+            moveFile(i, tmpRomPath(k)); // rename file to correct name and move file to tmp dir
+          } else {
+            filesys::copy_file(i, tmpRomPath(k));
           }
+          print("Renamed " + i + " to " + dat_data.rom_name[k]);
+          files_written[job].push_back(k);
         }
+      }
+      return;
+    }
 
-        if(!(sha1_is_duped)){ // can only break if SHA1 is not duplicated in DAT
-          break;
-        }
+    std::map<std::vector<std::string>, std::vector<int>> wanted;
+    for(auto &j: files_matches[job]){
+      if(!(j.rows.empty())){
+        wanted[j.chain] = j.rows;
       }
     }
-    if(!(hashMatchInDAT)){ // CRC32, MD5, SHA1 not in DAT
-      filesys::remove(i); // remove file
-      std::cout << "Deleted " << i << " (does not match DAT)" << std::endl;
+    if(!(wanted.empty())){
+      placeFromArchive(i, i, wanted, tmp_path + ".worker" + std::to_string(worker) + "/", files_written[job]);
+    }
+    if(files_written[job].empty()){
+      removeFile(i, "(nothing in it is needed)", false);
+    } else if(toRemove){ // if toRemove is false, archives that roms were copied from are kept, as those roms would be kept if they were not in an archive
+      filesys::remove(i);
+      print("Deleted " + i);
+    }
+  });
+
+  files_written.push_back(staged);
+  std::map<std::tuple<int, std::string>, std::vector<int>> set_rows; // key is index of profile and name of set, value is DAT entries written to its folder in tmp dir
+  for(auto &i: files_written){
+    for(int j: i){
+      to_zip.insert(std::make_tuple(dat_profile[j], dat_data.set_name[j]));
+      set_rows[std::make_tuple(dat_profile[j], dat_data.set_name[j])].push_back(j);
     }
   }
 
-  // zipping files
-  for(auto i: to_zip){
-    std::vector<std::string> files_to_zip = getAllFilesInDir(tmp_path+i);
-    write_zip(folder_path+i+".zip",files_to_zip,tmp_path+i+"/","2"); // writing zip file to folder  
-    filesys::remove_all(tmp_path+i); // delete tmp dir
+  // zipping files (into the set's zip, or whatever the set is already stored as, see container.h); each set is written once, by one worker
+  std::vector<std::map<std::string, setContainer>> containers;
+  for(auto i: profiles){
+    containers.push_back(getSetContainers(std::get<1>(i)));
+  }
+  std::vector<std::tuple<int, std::string>> sets(to_zip.begin(), to_zip.end());
+  std::vector<int> sets_written(sets.size()); // whether the roms were added to each set
+  parallelFor(sets.size(), [&](int job, int worker){
+    int p = std::get<0>(sets[job]);
+    std::string set_dir = tmpSetPath(p, std::get<1>(sets[job]));
+    std::vector<std::string> files_to_zip = getAllFilesInDir(set_dir);
+    if(!(addFilesToContainer(getSetContainer(containers[p], std::get<1>(profiles[p]), std::get<1>(sets[job])), files_to_zip, set_dir, set_dir.substr(0, set_dir.length() - 1) + ".work/", sorted))){
+      for(auto i: getAllFilesInDir(set_dir)){ // roms are kept, so they can be rebuilt again
+        recoverFile(i);
+      }
+      print("Could not add roms to " + std::get<1>(sets[job]) + ", moved them to " + recovered_dir);
+      return;
+    }
+    writeJournal("C " + rowsToString(set_rows.at(sets[job]))); // journaled before the copies in tmp dir are removed, so a rebuild that is stopped in between does not add them again
+    filesys::remove_all(set_dir); // delete tmp dir
+    sets_written[job] = 1;
+  });
+  for(int p = 0; p < profiles.size(); p++){
+    filesys::remove_all(tmp_path + std::to_string(p));
   }
   std::cout << "All files that match against DAT moved to romset" << std::endl;
 
-  // adding new entries to cache
-  cache_data = addToCache(dat_path,toAddToCache);
-
   if(toRemove){
-    filesys::remove_all(rebuild_path); // delete rebuild folder
-    filesys::create_directory(rebuild_path); // make a new rebuild folder
+    std::function<void(filesys::path)> clearFolder = [&](filesys::path folder){ // deletes what is in a rebuild folder, except recovered_dir
+      std::vector<filesys::path> entries{filesys::directory_iterator(folder), filesys::directory_iterator()};
+      for(auto &i: entries){
+        std::string path = i.string() + "/";
+        if(path == recovered_dir){
+          continue;
+        }
+        if(recovered_dir.rfind(path, 0) == 0){ // recovered_dir is in it
+          clearFolder(i);
+        } else {
+          filesys::remove_all(i);
+        }
+      }
+    };
+    for(auto i: rebuild_paths){
+      if(filesys::exists(i)){
+        clearFolder(i); // delete rebuild folder
+      }
+      filesys::create_directories(i); // make a new rebuild folder
+    }
+  }
+
+  for(int i = 0; i < sets.size(); i++){
+    if(sets_written[i]){
+      std::vector<int> &rows = set_rows.at(sets[i]);
+      journal.committed.insert(journal.committed.end(), rows.begin(), rows.end());
+    }
+  }
+  for(int j: journal.committed){ // roms added to sets, by this rebuild and the one that was stopped (if any)
+    toAddToCache[dat_profile[j]].push_back(std::make_tuple(dat_data.set_name[j], dat_data.rom_name[j], dat_data.crc32[j], dat_data.md5[j], dat_data.sha1[j], "Passed"));
+  }
+
+  dat_start.push_back(dat_data.sha1.size());
+  hashStore store = getHashStore();
+  std::set<std::string> dat_paths;
+  for(auto i: profiles){
+    dat_paths.insert(std::get<0>(i));
   }
+  removeFromHashStore(store, dat_paths);
+  for(int p = 0; p < profiles.size(); p++){
+    std::string dat_path = std::get<0>(profiles[p]);
+
+    // adding new entries to cache
+    cacheData cache_data = addToCache(dat_path,toAddToCache[p]);
+
+    // update hash store with where we have the roms now
+    datData profile_dat; // entries of this profile's DAT in dat_data
+    auto slice = [&](const std::vector<std::string> &from, std::vector<std::string> &to){
+      to.assign(from.begin() + dat_start[p], from.begin() + dat_start[p + 1]);
+    };
+    slice(dat_data.set_name, profile_dat.set_name);
+    slice(dat_data.rom_name, profile_dat.rom_name);
+    slice(dat_data.crc32, profile_dat.crc32);
+    slice(dat_data.md5, profile_dat.md5);
+    slice(dat_data.sha1, profile_dat.sha1);
+    slice(dat_data.size, profile_dat.size);
+    addToHashStore(store, dat_path, std::get<1>(profiles[p]), profile_dat, cache_data);
 
-  // counting number of sets and roms that are present
-  cache_data = getDataFromCache(dat_path); // need to do this or else set/rom count will be wrong
-  std::tuple<int, int, int, int> count = countSetsRoms(cache_data);
+    // counting number of sets and roms that are present
+    std::tuple<int, int, int, int> count = countSetsRoms(cache_data);
 
-  // update cache with set/rom count
-  updateCacheCount(dat_path, cache_path, folder_path, count);
+    // update cache with set/rom count
+    updateCacheCount(dat_path, std::get<0>(getCachePath(dat_path)), std::get<1>(profiles[p]), count);
+
+    std::cout << std::endl;
+    if(profiles.size() > 1){
+      std::cout << dat_path << std::endl;
+    }
+    printCount(count);
+  }
+  writeHashStore(store);
 
-  std::cout << std::endl;
-  printCount(count);
+  journal_file.close();
+  filesys::remove(getRebuildJournalPath()); // rebuild is done, so there is nothing to carry on from
 }
\ No newline at end of file
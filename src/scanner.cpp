@@ -7,6 +7,9 @@
 #include <algorithm>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
 
 #include <pugixml.hpp>
 
@@ -18,6 +21,12 @@
 #include <dir2dat.h>
 #include <cache.h>
 #include <dat.h>
+#include <hashstore.h>
+#include <threadpool.h>
+#include <workspace.h>
+#include <container.h>
+#include <zipedit.h>
+#include <rebuilder.h>
 #include "../include/archive.h"
 #include <scanner.h>
 
@@ -147,53 +156,49 @@ std::vector<std::string> diff(std::set<std::string> s1, std::set<std::string> s2
  *
  * Returns:
  *     count : Tuple containing set have, set total, rom have, rom total (in that order)
+ *
+ * Notes:
+ *     The counts are kept up to date by getDataFromCache()/addToCache() as entries change, so this does not walk the cache. Use recountSetsRoms() to verify them.
+ */
+std::tuple<int, int, int, int> countSetsRoms(const cacheData &cache_data){
+  std::tuple<int, int, int, int> count = std::make_tuple(cache_data.sets_have,cache_data.sets_total,cache_data.roms_have,cache_data.roms_total);
+  return count;
+}
+
+/*
+ * Recounts number of sets have/total and roms have/total by going through every entry in cache
+ *
+ * Arguments:
+ *     cache_data : Struct containing cache data (see definition in cache.h)
+ *
+ * Returns:
+ *     count : Tuple containing set have, set total, rom have, rom total (in that order)
+ *
+ * Notes:
+ *     Only meant for verifying the counts maintained in cache_data; countSetsRoms() should be used otherwise
  */
-std::tuple<int, int, int, int> countSetsRoms(cacheData cache_data){
-  std::vector<std::tuple<std::string,int,int>> set_count; // each tuple consists of the set name, roms have for that set, roms total for that set
-  bool repeated_entry = false; // true if there's an element in set_count with the same set name; false if otherwise
-  int index;
+std::tuple<int, int, int, int> recountSetsRoms(const cacheData &cache_data){
+  std::unordered_map<std::string, std::tuple<int, int>> set_count; // key is the set name, value is roms have, roms total for that set
   int roms_have = 0;
   int roms_total = 0;
 
   for(int i = 0; i < cache_data.status.size(); i++){
-    for(int j = 0; j < set_count.size(); j++){
-      if(std::get<0>(set_count[j]) == cache_data.set_name[i]){
-        repeated_entry = true;
-        index = j; // index of that set name in set_count
-        break;
-      } else {
-        repeated_entry = false;
-      }
-    }
-
+    std::tuple<int, int> &count = set_count[cache_data.set_name[i]];
     if(cache_data.status[i] == "Passed"){
       roms_have += 1;
-      roms_total += 1;
-      if(repeated_entry){ // add 1 to roms have and roms total (for that set) in set_count
-        std::get<1>(set_count[index]) += 1;
-        std::get<2>(set_count[index]) += 1;
-      } else {
-        set_count.push_back(std::make_tuple(cache_data.set_name[i],1,1)); // make a new entry in set_count with that set name
-      }
-    } else {
-      roms_total += 1;
-      if(repeated_entry){ // add 1 to roms total (for that set) in set_count, don't touch roms have (for that set) in set_count since its missing
-        std::get<2>(set_count[index]) += 1;
-      } else {
-        set_count.push_back(std::make_tuple(cache_data.set_name[i],0,1)); // make a new entry in set_count with that set name
-      }
+      std::get<0>(count) += 1;
     }
+    roms_total += 1;
+    std::get<1>(count) += 1;
   }
 
   int sets_have = 0;
   int sets_total = 0;
   for(auto i: set_count){
-    if(std::get<1>(i) == std::get<2>(i)){ // if roms have == roms total (for that set) (i.e. we have all the roms in that set), we add 1 to sets_have and sets_total
+    if(std::get<0>(i.second) == std::get<1>(i.second)){ // if roms have == roms total (for that set) (i.e. we have all the roms in that set), we add 1 to sets_have
       sets_have += 1;
-      sets_total += 1;
-    } else { // if roms have != roms total (for that set) (i.e. the set is incomplete), we add 1 to sets_total and don't touch sets_have
-      sets_total += 1;
     }
+    sets_total += 1;
   }
 
   std::tuple<int, int, int, int> count = std::make_tuple(sets_have,sets_total,roms_have,roms_total);
@@ -264,6 +269,309 @@ void printCount(std::tuple<int, int, int, int> count){
   std::cout << termcolor::reset << std::endl;
 }
 
+/*
+ * Describes an action of a scan plan
+ *
+ * Arguments:
+ *     action : Action (see definition of scanAction in scanner.h)
+ *     folder_path : Path to the romset (*Path must end with a forward slash)
+ *     containers : Containers of the romset, as from getSetContainers() before the plan is carried out
+ *     done : Whether the action has been carried out (past tense) or not
+ *
+ * Returns:
+ *     description : e.g. "Renamed a.rom in /roms/Set.zip to b.rom"
+ */
+std::string describeAction(const scanAction &action, std::string folder_path, const std::map<std::string, setContainer> &containers, bool done){
+  auto setPath = [&](std::string set_name){ // sets that don't exist yet are shown without an extension, as their type is decided when they are written
+    auto it = containers.find(set_name);
+    return it == containers.end() ? folder_path + set_name : it->second.path;
+  };
+  std::string set_path = setPath(action.set_name);
+  if(action.type == "backup"){
+    return (done ? "Moved " : "Move ") + action.rom_name + " in " + set_path + " to backup folder";
+  } else if (action.type == "rename"){
+    return (done ? "Renamed " : "Rename ") + action.rom_name + " in " + set_path + " to " + action.new_rom_name;
+  }
+  std::string description = (done ? "Moved " : "Move ") + action.rom_name + " in " + set_path + " to " + setPath(action.new_set_name);
+  if(action.new_rom_name != action.rom_name){
+    description += " as " + action.new_rom_name;
+  }
+  return description;
+}
+
+/*
+ * Carries out a scan plan. Every set that is changed is read and written once, however many actions it has.
+ *
+ * Arguments:
+ *     folder_path : Path to the romset (*Path must end with a forward slash)
+ *     plan : Vector containing actions (see definition of scanAction in scanner.h), as made by scan()
+ *     sorted (Optional) : true to keep entries of zips that are written in order of name; zips are then only renamed in place if their entries stay in order, and only appended to if the new roms sort after the ones in the zip (see appendZip())
+ *
+ * Notes:
+ *     Sets keep the container they are in (see container.h); a set that does not exist yet gets the type of the set its first rom comes from. A "file" set that no longer holds exactly one rom named as the set becomes a directory.
+ *     Roms moved to backup folder are extracted in memory (one extraction per zip/7z, see workspace.h); files of uncompressed sets are moved as they are. Zips that only have roms renamed are renamed in place with renameInZip(), and zips that only have roms added are appended to in place with appendZip(); other zips are written next to the old ones with repackZip(), which copies entries without decompressing them; if a zip can't be repacked (or roms come from a 7z), the sets it takes roms from are extracted in memory and the roms rezipped instead. 7zs are always rewritten from memory, uncompressed sets have their files moved.
+ *     The old sets are only replaced once all new sets are written, since a set can be read for roms moved out of it after it has been written.
+ */
+void executePlan(std::string folder_path, const std::vector<scanAction> &plan, bool sorted){
+  std::map<std::string, setContainer> containers = getSetContainers(folder_path);
+  std::map<std::string, std::map<std::string, const scanAction *>> leaving; // key is set name, value is map with key as rom name, value as action of rom
+  std::map<std::string, std::vector<std::string>> backups; // key is set name, value is names of roms to move to backup folder
+  std::map<std::string, std::vector<std::tuple<std::string, std::string, std::string>>> members; // key is set name, value is vector of tuples containing set name the rom comes from, its name there and its name in the set, once the plan is carried out
+  std::set<std::string> unlisted; // sets whose zip can't be read by getZipEntryNames(); what stays in them is found by extracting them
+  auto addStaying = [&](std::string set_name){ // adds roms that stay in the set (renamed or not), in the order they are in the set
+    auto container = containers.find(set_name);
+    if(container == containers.end()){
+      return;
+    }
+    std::vector<std::string> names = getContainerEntryNames(container->second);
+    if(names.empty() && container->second.type == "zip"){
+      unlisted.insert(set_name);
+    }
+    std::map<std::string, const scanAction *> &set_leaving = leaving[set_name];
+    for(auto j: names){
+      auto it = set_leaving.find(j);
+      if(it == set_leaving.end()){
+        members[set_name].push_back(std::make_tuple(set_name, j, j));
+      } else if (it->second->type == "rename"){
+        members[set_name].push_back(std::make_tuple(set_name, j, it->second->new_rom_name));
+      }
+    }
+  };
+
+  for(auto &i: plan){
+    leaving[i.set_name][i.rom_name] = &i;
+    if(i.type == "backup"){
+      backups[i.set_name].push_back(i.rom_name);
+    }
+  }
+  for(auto &i: plan){
+    if(!(members.count(i.set_name))){
+      members[i.set_name];
+      addStaying(i.set_name);
+    }
+  }
+  for(auto &i: plan){ // then roms moved from other sets
+    if(i.type == "move"){
+      if(!(members.count(i.new_set_name))){ // set is not changed otherwise, so it keeps all its roms
+        members[i.new_set_name];
+        addStaying(i.new_set_name);
+      }
+      members[i.new_set_name].push_back(std::make_tuple(i.set_name, i.rom_name, i.new_rom_name));
+    }
+  }
+
+  // moving roms to backup folder
+  std::vector<std::string> sets;
+  for(auto &i: backups){
+    sets.push_back(i.first);
+  }
+  std::mutex print_mutex;
+  parallelFor(sets.size(), [&](int job, int worker){
+    std::string i = sets[job];
+    const setContainer &container = containers.at(i);
+    if(container.type == "dir" || container.type == "file"){
+      for(auto j: backups[i]){
+        filesys::create_directories(filesys::path(backup_path+i+"/"+j).parent_path()); // directories in rom name are made in backup dir
+        moveFile(getContainerFilePath(container, j), backup_path+i+"/"+j);
+      }
+      return;
+    }
+
+    std::string scratch_dir = tmp_path + ".worker" + std::to_string(worker) + "/";
+    workspace ws;
+    initWorkspace(ws, scratch_dir);
+    extractToWorkspace(ws, container.path);
+    std::vector<std::tuple<std::string, std::string, std::string>> unreadable; // roms that could not be extracted (corrupted); these are copied as they are into a zip in backup folder
+    for(auto j: backups[i]){
+      if(!(writeFromWorkspace(ws, j, backup_path+i+"/"+j))){ // directories in rom name are made in backup dir
+        unreadable.push_back(std::make_tuple(container.path, j, j));
+      }
+    }
+    if(!(unreadable.empty())){
+      std::string backup_zip = backup_path+i+".zip";
+      if(filesys::exists(backup_zip)){ // keep what is already there
+        for(auto j: getZipEntryNames(backup_zip)){
+          unreadable.push_back(std::make_tuple(backup_zip, j, j));
+        }
+      }
+      if(container.type != "zip" || !(repackZip(backup_zip, unreadable))){ // entries of a 7z can't be copied as they are
+        std::lock_guard<std::mutex> lock(print_mutex);
+        std::cout << "Could not back up corrupted roms of " << container.path << std::endl;
+      }
+    }
+    clearWorkspace(ws);
+    filesys::remove_all(scratch_dir);
+  });
+
+  // deciding where sets go
+  sets.clear();
+  std::vector<setContainer> targets; // container each set is written to
+  for(auto &i: members){
+    sets.push_back(i.first);
+    auto existing = containers.find(i.first);
+    std::string type = existing != containers.end() ? existing->second.type : (i.second.empty() ? "zip" : containers.at(std::get<0>(i.second.front())).type);
+    if(type == "file"){
+      std::vector<std::string> files;
+      for(auto j: i.second){
+        if(std::get<2>(j).back() != '/'){
+          files.push_back(std::get<2>(j));
+        }
+      }
+      if(files.size() == 1 && files[0].find('/') == std::string::npos && filesys::path(files[0]).stem().string() == i.first){
+        targets.push_back({folder_path + files[0], "file"});
+      } else {
+        targets.push_back({folder_path + i.first + "/", "dir"});
+      }
+    } else if (type == "dir"){
+      targets.push_back({folder_path + i.first + "/", "dir"});
+    } else {
+      targets.push_back({folder_path + i.first + "." + type, type});
+    }
+  }
+  auto newPath = [&](const setContainer &target){ // where a set is written before it replaces the old one
+    return target.type == "dir" ? target.path.substr(0, target.path.length() - 1) + ".new/" : target.path + ".new";
+  };
+
+  // writing new sets
+  std::vector<int> has_files(sets.size()); // whether new set has any files (if not, the set is removed)
+  std::mutex bar_mutex;
+  ProgressBar bar(sets.size());
+  bar.SetFrequencyUpdate(50);
+  int jobindex = 0;
+
+  parallelFor(sets.size(), [&](int job, int worker){
+    std::string i = sets[job];
+    const setContainer &target = targets[job];
+    std::string new_path = newPath(target);
+    std::string scratch_dir = tmp_path + ".worker" + std::to_string(worker) + "/";
+    std::vector<std::tuple<std::string, std::string, std::string>> set_members = members[i];
+    std::map<std::string, workspace> extracted; // key is set name, value is files of its zip/7z
+    auto extractSet = [&](std::string set_name) -> workspace & { // extracts a set's zip/7z (once) in memory
+      if(!(extracted.count(set_name))){
+        std::string spill_dir = scratch_dir + std::to_string(extracted.size()) + "/";
+        initWorkspace(extracted[set_name], spill_dir);
+        extractToWorkspace(extracted[set_name], containers.at(set_name).path);
+      }
+      return extracted[set_name];
+    };
+
+    if(unlisted.count(i)){ // extract zip to find roms that stay in the set
+      auto set_leaving = leaving.find(i);
+      std::vector<std::tuple<std::string, std::string, std::string>> staying;
+      for(auto &j: extractSet(i).entries){
+        std::string name = j.first; // name of file in zip
+        if(set_leaving == leaving.end() || !(set_leaving->second.count(name))){
+          staying.push_back(std::make_tuple(i, name, name));
+        } else if (set_leaving->second.at(name)->type == "rename"){
+          staying.push_back(std::make_tuple(i, name, set_leaving->second.at(name)->new_rom_name));
+        }
+      }
+      set_members.insert(set_members.begin(), staying.begin(), staying.end());
+    }
+    for(auto j: set_members){
+      if(std::get<2>(j).back() != '/'){ // not a directory
+        has_files[job] = 1;
+      }
+    }
+
+    if(has_files[job] && target.type == "zip"){
+      std::vector<std::tuple<std::string, std::string, std::string>> zip_members; // see repackZip()
+      bool repackable = extracted.empty();
+      for(auto j: set_members){
+        const setContainer &source = containers.at(std::get<0>(j));
+        if(source.type == "zip"){
+          zip_members.push_back(std::make_tuple(source.path, std::get<1>(j), std::get<2>(j)));
+        } else if (source.type == "dir" || source.type == "file"){
+          if(std::get<2>(j).back() != '/'){
+            zip_members.push_back(std::make_tuple(getContainerFilePath(source, std::get<1>(j)), "", std::get<2>(j)));
+          }
+        } else {
+          repackable = false;
+        }
+      }
+      auto existing = containers.find(i);
+      auto set_leaving = leaving.find(i);
+      std::map<std::string, std::string> renames; // key is name of rom in the set's zip, value is its new name; only if roms are only renamed within the set
+      bool only_renamed = set_leaving != leaving.end() && !(set_leaving->second.empty()) && std::all_of(set_leaving->second.begin(), set_leaving->second.end(), [](const std::pair<const std::string, const scanAction *> &j){ return j.second->type == "rename"; });
+      for(auto j: set_members){
+        only_renamed = only_renamed && std::get<0>(j) == i; // no roms come from other sets
+        if(only_renamed && std::get<1>(j) != std::get<2>(j)){
+          renames[std::get<1>(j)] = std::get<2>(j);
+        }
+      }
+      bool in_order = true; // whether the roms are in order of name as they are (renaming keeps the order of the zip's entries)
+      if(sorted){
+        auto by_name = [](const std::tuple<std::string, std::string, std::string> &a, const std::tuple<std::string, std::string, std::string> &b){ return std::get<2>(a) < std::get<2>(b); };
+        in_order = std::is_sorted(zip_members.begin(), zip_members.end(), by_name);
+        std::stable_sort(zip_members.begin(), zip_members.end(), by_name);
+      }
+      bool same_zip = repackable && existing != containers.end() && existing->second.path == target.path; // set is written back to the zip it is in
+      if(same_zip && only_renamed && in_order && renameInZip(target.path, renames)){ // no other set reads this zip, as no roms leave it
+        has_files[job] = 3; // written in place
+      } else if(same_zip && (set_leaving == leaving.end() || set_leaving->second.empty()) && appendZip(target.path, zip_members, "2", sorted)){ // roms are only added, so no other set reads this zip while it is written
+        has_files[job] = 3; // written in place
+      } else if (repackable && repackZip(new_path, zip_members)){
+        has_files[job] = 2; // written
+      }
+    }
+
+    if(has_files[job] == 1){ // extract the zips/7zs the set takes roms from (in memory), and write the roms
+      workspace set_ws;
+      initWorkspace(set_ws, scratch_dir + "set/");
+      for(auto j: set_members){
+        const setContainer &source = containers.at(std::get<0>(j));
+        if(std::get<2>(j).back() == '/'){
+          continue;
+        }
+        std::string destination = target.type == "file" ? new_path : new_path + std::get<2>(j); // for uncompressed sets
+        if(source.type == "dir" || source.type == "file"){
+          std::string source_path = getContainerFilePath(source, std::get<1>(j));
+          if(target.type == "dir" || target.type == "file"){ // file is moved as it is
+            filesys::create_directories(filesys::path(destination).parent_path());
+            moveFile(source_path, destination);
+          } else {
+            addFileToWorkspace(set_ws, source_path, std::get<2>(j), true);
+          }
+        } else {
+          moveToWorkspace(extractSet(std::get<0>(j)), std::get<1>(j), set_ws, std::get<2>(j));
+          if(target.type == "dir" || target.type == "file"){
+            writeFromWorkspace(set_ws, std::get<2>(j), destination);
+          }
+        }
+      }
+      if(target.type == "zip" || target.type == "7z"){
+        writeContainer({new_path, target.type}, set_ws, scratch_dir + "zip/");
+      }
+      clearWorkspace(set_ws);
+    }
+    for(auto &j: extracted){
+      clearWorkspace(j.second);
+    }
+    filesys::remove_all(scratch_dir);
+
+    std::lock_guard<std::mutex> lock(bar_mutex);
+    jobindex++;
+    bar.Progressed(jobindex);
+  });
+
+  // replacing old sets
+  for(int i = 0; i < sets.size(); i++){
+    if(has_files[i] == 3){
+      continue;
+    }
+    auto existing = containers.find(sets[i]);
+    if(existing != containers.end()){
+      removeContainer(existing->second);
+    }
+    std::string new_path = newPath(targets[i]);
+    if(has_files[i]){
+      filesys::rename(new_path, targets[i].path);
+    } else if (filesys::exists(new_path)){
+      filesys::remove_all(new_path);
+    }
+  }
+}
+
 /*
  * Scans a romset, makes all set name, rom name and CRC32 of files in folder match DAT. Outputs sets have/missing, roms have/missing to terminal. Also keeps track of what is present (and what isin't) via a cache.
  * If a header skipper XML is present, header skipping support is enabled. (If <data> matches, hash will be calculated from start offset to end of file; if not, hash is calculated over the entire file). scan() looks for the header XML as such: e.g. if dat_path = dats_path + "/No-Intro/Atari - 7800 (date).dat", header_path = headers_path + "/No-Intro/Atari - 7800.xml"
@@ -271,8 +579,18 @@ void printCount(std::tuple<int, int, int, int> count){
  * Arguments:
  *     dat_path : Path to DAT file
  *     folder_path : Path to folder to be scanned against the DAT file, i.e. path to the romset (*Path must end with a forward slash)
+ *     dry_run (Optional) : Whether to only print what needs to be renamed/moved (nothing in the folder or cache is changed)
+ *     quick (Optional) : Whether to skip zips that are unchanged since the last scan (same size and modification time, or same central directory), without opening them
+ *     verify (Optional) : Whether to decompress every rom and check its CRC32 against the zip and its CRC32, MD5 and SHA1 against DAT; roms that fail are moved to backup folder (overrides quick)
+ *     changed_sets (Optional) : Names of sets that may have changed since the last scan (e.g. as seen by watch()); if not empty, other sets that were there at the last scan are not looked at, as if they were unchanged (use with quick)
+ *     update_store (Optional) : Whether to update the hash store with this DAT's rows; false when the caller updates it once for several scans (see refreshHashStore())
+ *     sorted (Optional) : Whether to keep entries of zips that are written in order of name (see executePlan())
+ *
+ * Notes:
+ *     A plan (what has to be moved to backup folder, renamed and moved to other sets) is made for all sets first, then carried out by executePlan()
+ *     Sets can be zips, 7zs, directories or single files (see getSetContainers()); 7zs are listed from their header, files of uncompressed sets are read to get their CRC32
  */
-void scan(std::string dat_path, std::string folder_path){
+void scan(std::string dat_path, std::string folder_path, bool dry_run, bool quick, bool verify, const std::set<std::string> &changed_sets, bool update_store, bool sorted){
   // checks
   if(!(filesys::exists(dat_path))){
     std::cout << dat_path << " does not exist!" << std::endl;
@@ -302,7 +620,7 @@ void scan(std::string dat_path, std::string folder_path){
   }
   
   // getting info on files in folder, DAT, cache
-  std::set<std::string> files_in_folder = getAllFilesInDir2(folder_path);
+  std::map<std::string, setContainer> containers = getSetContainers(folder_path, true); // sets in folder; each is a zip, 7z, directory or file (see container.h)
   datData dat_data = getDataFromDAT(dat_path);
   cacheData cache_data = getDataFromCache(dat_path);
 
@@ -335,217 +653,308 @@ void scan(std::string dat_path, std::string folder_path){
     std::cout << "Using header skipper " << header_path << std::endl;
   }
 
-  // comparing files in folder with files in DAT; making sure all CRCs of files in folder match DAT; moves non-matching files to backup folder
-  std::set<std::string> to_zip; // vector containing names of folders in tmp/ to zip; set so duplicates won't get inserted
-  ProgressBar bar(files_in_folder.size());
-  bar.SetFrequencyUpdate(50);
+  // lookups used by every set; read-only while sets are planned in parallel
+  std::unordered_set<std::string> passed_rom_names; // rom names that are "Passed" in cache (in any set)
+  for(int i = 0; i < cache_data.rom_name.size(); i++){
+    if(cache_data.status[i] == "Passed"){
+      passed_rom_names.insert(cache_data.rom_name[i]);
+    }
+  }
+  std::unordered_set<std::string> crc_dupes(dat_data.crc_dupes.begin(), dat_data.crc_dupes.end());
+  std::unordered_map<std::string, int> first_with_crc32; // key is CRC32, value is index of first entry in DAT with that CRC32
+  std::unordered_map<std::string, int> first_with_sha1; // key is SHA1, value is index of first entry in DAT with that SHA1
+  for(int i = 0; i < dat_data.set_name.size(); i++){
+    first_with_crc32.emplace(dat_data.crc32[i], i);
+    first_with_sha1.emplace(dat_data.sha1[i], i);
+  }
+  std::unordered_set<std::string> dat_size_crc32; // size and CRC32 of every entry in DAT, as "size/CRC32" (only with header skipper)
+  std::unordered_set<std::string> headered_sizes; // sizes that entries in DAT have with a header in front of them (only with header skipper)
+  if(scanningWithHeaders){
+    for(int i = 0; i < dat_data.set_name.size(); i++){
+      std::string crc32 = dat_data.crc32[i];
+      std::transform(crc32.begin(), crc32.end(), crc32.begin(), ::toupper);
+      dat_size_crc32.insert(dat_data.size[i] + "/" + crc32);
+      if(!(dat_data.size[i].empty()) && std::all_of(dat_data.size[i].begin(), dat_data.size[i].end(), ::isdigit)){
+        headered_sizes.insert(std::to_string(std::stoull(dat_data.size[i]) + start_offset));
+      }
+    }
+  }
+  auto getNames = [&](const std::unordered_map<std::string, int> &first_with_hash, const std::string &hash){ // same as getNameFromHash(), without parsing the DAT again
+    auto it = first_with_hash.find(hash);
+    if(it == first_with_hash.end()){
+      return std::make_tuple(std::string(), std::string());
+    }
+    return std::make_tuple(dat_data.set_name[it->second], dat_data.rom_name[it->second]);
+  };
+  auto toResolve = [&](const std::string &set_name, const std::map<std::string, std::string> &zipinfo){ // whether a set has roms that are not "Passed" in cache, so its set and rom names have to be checked
+    for(auto j: zipinfo){
+      auto it = cache_data.entry_index.find(entryKey(set_name, j.first));
+      if(it == cache_data.entry_index.end() || cache_data.status[it->second] != "Passed"){
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // planning: works out what has to be done to every set without changing anything in the folder. roms are read from the zips' central directories; zips are only extracted to get SHA1 (if CRC is duplicated in DAT) or to hash with headers skipped
+  // each set is planned on its own in a scratch dir per worker, so sets are planned in parallel
+  std::vector<std::string> sets;
+  for(auto &i: containers){
+    sets.push_back(i.first);
+  }
+  std::vector<std::vector<scanAction>> sets_backups(sets.size()); // roms whose CRC32/SHA1 does not match DAT, for each set
+  std::vector<std::map<std::string, std::string>> sets_zipinfo(sets.size()); // key is rom name, value is CRC32 (only roms that are not moved to backup folder)
+  std::vector<std::map<std::string, std::string>> sets_sha1(sets.size()); // key is rom name, value is SHA1 (only for roms whose CRC is duplicated in DAT)
+  std::map<std::string, std::tuple<std::string, std::string, std::string>> zip_stats = getZipStats(dat_path); // zip stats from last scan (see getZipStats())
+  std::vector<std::tuple<std::string, std::string, std::string>> sets_stat(sets.size()); // size, modification time, central directory CRC32 of zip of each set (see getContainerStat() and getContainerListingCRC32() for other sets)
+  std::vector<int> sets_skipped(sets.size()); // whether set's zip is unchanged since last scan and was not opened (quick scan)
+  std::mutex bar_mutex;
   int jobindex = 0;
 
-  for(auto i: files_in_folder){
-    jobindex++;
-    bar.Progressed(jobindex);
+  // verifying: every rom is decompressed and hashed straight from its zip/7z (nothing is extracted), so its CRC32 can be checked against the zip's central directory (or the 7z's header) and its CRC32, MD5 and SHA1 against DAT; files of uncompressed sets are only checked against DAT
+  // zips are hashed in parallel; big zips are split into parts that are hashed by several workers at once
+  std::vector<std::map<std::string, std::string>> sets_header_crc32(sets.size()); // key is rom name, value is CRC32 in zip's central directory (only when verifying); for uncompressed sets, CRC32 of the file once it is hashed
+  std::vector<std::map<std::string, std::vector<std::string>>> sets_verified(sets.size()); // key is rom name, value is hashes of rom (see hashArchive()) (only when verifying)
+  std::vector<int> sets_corrupted(sets.size()); // number of roms in each set that could not be decompressed or whose CRC32 does not match the zip's central directory
+  std::vector<int> sets_mismatched(sets.size()); // number of roms in each set whose hashes do not match any entry in DAT
+  std::unordered_multimap<std::string, int> dat_by_crc32; // key is CRC32, value is index of entry in DAT with that CRC32 (only when verifying)
+  if(verify){
+    for(int i = 0; i < dat_data.set_name.size(); i++){
+      dat_by_crc32.emplace(dat_data.crc32[i], i);
+    }
+
+    std::vector<std::tuple<int, int, int>> verify_jobs; // index of set, part, no. of parts
+    parallelFor(sets.size(), [&](int job, int worker){
+      const setContainer &container = containers.at(sets[job]);
+      if(container.type == "zip" || container.type == "7z"){
+        sets_header_crc32[job] = getContainerInfo(container);
+      } else { // files are only read once, when they are hashed
+        for(auto j: getContainerEntryNames(container)){
+          sets_header_crc32[job][j];
+        }
+      }
+    });
+    for(int i = 0; i < sets.size(); i++){
+      std::string set_size = std::get<0>(getContainerStat(containers.at(sets[i])));
+      unsigned long long zip_size = set_size == "-" ? 0 : std::stoull(set_size);
+      int no_of_parts = std::min({(unsigned long long)getNoOfWorkers(), (unsigned long long)sets_header_crc32[i].size(), 1 + zip_size / (1024 * 1024 * 64)}); // one part for every 64MiB
+      for(int j = 0; j < std::max(no_of_parts, 1); j++){
+        verify_jobs.push_back(std::make_tuple(i, j, std::max(no_of_parts, 1)));
+      }
+    }
+
+    std::vector<std::map<std::string, std::vector<std::string>>> parts(verify_jobs.size());
+    ProgressBar verify_bar(verify_jobs.size());
+    verify_bar.SetFrequencyUpdate(50);
+    parallelFor(verify_jobs.size(), [&](int job, int worker){
+      std::tuple<int, int, int> verify_job = verify_jobs[job];
+      const setContainer &container = containers.at(sets[std::get<0>(verify_job)]);
+      if(scanningWithHeaders){
+        parts[job] = hashContainer(container, start_offset, info, std::get<1>(verify_job), std::get<2>(verify_job));
+      } else {
+        parts[job] = hashContainer(container, -1, {}, std::get<1>(verify_job), std::get<2>(verify_job));
+      }
 
+      std::lock_guard<std::mutex> lock(bar_mutex);
+      jobindex++;
+      verify_bar.Progressed(jobindex);
+    });
+    for(int i = 0; i < verify_jobs.size(); i++){
+      sets_verified[std::get<0>(verify_jobs[i])].insert(parts[i].begin(), parts[i].end());
+    }
+    for(int i = 0; i < sets.size(); i++){
+      std::string type = containers.at(sets[i]).type;
+      if(type == "dir" || type == "file"){
+        for(auto &j: sets_verified[i]){
+          if(!(j.second.empty())){
+            sets_header_crc32[i][j.first] = j.second[4];
+          }
+        }
+      }
+    }
+    jobindex = 0;
+  }
+  auto sameHash = [](const std::string &a, const std::string &b){ // hashes in DAT are not always uppercase
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y){ return ::toupper(x) == ::toupper(y); });
+  };
+  auto matchesDAT = [&](const std::string &crc32, const std::string &md5, const std::string &sha1){ // whether an entry in DAT has these hashes (hashes that DAT does not have are not compared)
+    auto range = dat_by_crc32.equal_range(crc32);
+    for(auto it = range.first; it != range.second; ++it){
+      int k = it->second;
+      if((dat_data.md5[k].empty() || sameHash(dat_data.md5[k], md5)) && (dat_data.sha1[k].empty() || sameHash(dat_data.sha1[k], sha1))){
+        return true;
+      }
+    }
+    return false;
+  };
+  std::vector<std::map<std::string, std::string>> sets_md5(sets.size()); // key is rom name, value is MD5 (only when verifying)
+
+  ProgressBar bar(sets.size());
+  bar.SetFrequencyUpdate(50);
+
+  parallelFor(sets.size(), [&](int job, int worker){
+    std::string i = sets[job];
+    std::string scratch_dir = tmp_path + ".worker" + std::to_string(worker) + "/";
     std::map<std::string, std::string> zipinfo;
+    std::map<std::string, std::string> &sha1s = sets_sha1[job];
+    const setContainer &container = containers.at(i);
+    workspace ws; // files of the zip/7z, if it had to be extracted
+    initWorkspace(ws, scratch_dir);
     bool is_extracted = false;
 
-    if(scanningWithHeaders){
-      std::string tmp_dir = tmp_path + i + "/";
-      extract(folder_path+i+".zip",tmp_dir);
-      is_extracted = true;
+    // a zip is unchanged if its size and modification time are the same as at the last scan, or if they aren't but its central directory is (the same goes for a 7z and its header)
+    auto it = zip_stats.find(i);
+    bool is_unchanged = false;
+    if(!(changed_sets.empty()) && !(changed_sets.count(i)) && it != zip_stats.end()){ // caller knows the set has not changed since the last scan, so it is not looked at
+      sets_stat[job] = it->second;
+      is_unchanged = true;
+    } else {
+      std::tuple<std::string, std::string> zip_stat = getContainerStat(container);
+      std::string central_dir_crc32;
+      if(it != zip_stats.end() && std::get<0>(it->second) == std::get<0>(zip_stat) && std::get<1>(it->second) == std::get<1>(zip_stat)){
+        central_dir_crc32 = std::get<2>(it->second);
+        is_unchanged = true;
+      } else {
+        central_dir_crc32 = getContainerListingCRC32(container);
+        is_unchanged = it != zip_stats.end() && central_dir_crc32 != "-" && std::get<2>(it->second) == central_dir_crc32;
+      }
+      sets_stat[job] = std::make_tuple(std::get<0>(zip_stat), std::get<1>(zip_stat), central_dir_crc32);
+    }
 
-      std::vector<std::string> files = getAllFilesInDir(tmp_dir);
-      for(auto j: files){
-        std::vector<std::string> fileinfo = getHashes(j, start_offset, info);
-        std::string filename = filesys::path(j).filename();
-        zipinfo[filename] = fileinfo[1];
+    if(quick && is_unchanged && !(verify)){ // everything in zip was sorted out by the last scan
+      sets_skipped[job] = 1;
+    } else if(verify){
+      for(auto j: sets_header_crc32[job]){
+        auto verified = sets_verified[job].find(j.first);
+        if(verified == sets_verified[job].end() || verified->second.empty() || verified->second[4] != j.second){ // rom could not be decompressed, or CRC32 of its data does not match zip
+          sets_backups[job].push_back({"backup", i, j.first, i, j.first});
+          sets_corrupted[job] += 1;
+          continue;
+        }
+        std::vector<std::string> &hashes = verified->second;
+        if(!(matchesDAT(scanningWithHeaders ? hashes[1] : j.second, hashes[2], hashes[3]))){ // CRC32 matches zip, but the rom is not in DAT (e.g. same CRC32, different SHA1)
+          sets_backups[job].push_back({"backup", i, j.first, i, j.first});
+          sets_mismatched[job] += 1;
+          continue;
+        }
+        zipinfo[j.first] = scanningWithHeaders ? hashes[1] : j.second;
+        sets_md5[job][j.first] = hashes[2];
+        sha1s[j.first] = hashes[3];
+      }
+    } else if(scanningWithHeaders){
+      // roms whose size and CRC32 (from the zip's central directory) match DAT have no header, so they are taken as they are; only roms that could be a DAT entry with a header in front of it are hashed (without extracting) with the header skipper
+      std::map<std::string, std::string> sizes;
+      std::set<std::string> to_hash;
+      for(auto j: getContainerInfo(container, &sizes)){
+        if(!(dat_size_crc32.count(sizes[j.first] + "/" + j.second)) && headered_sizes.count(sizes[j.first])){
+          to_hash.insert(j.first);
+        } else { // no header, or not in DAT either way (moved to backup folder below)
+          zipinfo[j.first] = j.second;
+        }
+      }
+      if(!(to_hash.empty())){
+        for(auto &j: hashContainer(container, start_offset, info, 0, 1, to_hash)){
+          if(j.second.empty()){ // corrupted
+            continue;
+          }
+          zipinfo[j.first] = j.second[1];
+          sha1s[j.first] = j.second[3];
+        }
       }
     } else {
-      zipinfo = getInfoFromZip(folder_path+i+".zip");
+      zipinfo = getContainerInfo(container);
     }
 
+    auto getSHA1 = [&](const std::string &file_rom_name){
+      if(!(sha1s.count(file_rom_name)) && (container.type == "dir" || container.type == "file")){
+        sha1s[file_rom_name] = getHashes(getContainerFilePath(container, file_rom_name))[3];
+      } else if(!(sha1s.count(file_rom_name))){
+        if(!(is_extracted)){
+          extractToWorkspace(ws, container.path);
+          is_extracted = true;
+        }
+        std::vector<std::string> fileinfo = hashInWorkspace(ws, file_rom_name);
+        sha1s[file_rom_name] = fileinfo.empty() ? "-" : fileinfo[3]; // "-" if rom could not be extracted (corrupted)
+      }
+      return sha1s[file_rom_name];
+    };
+
     for(auto j: zipinfo){
       std::string file_rom_name = j.first;
       std::string crc32 = j.second;
-      bool inCache = false;
-      for(int i = 0; i < cache_data.rom_name.size(); i++){
-        if(cache_data.rom_name[i] == file_rom_name && cache_data.status[i] == "Passed"){ // if it's already in cache and "Passed", no need to check hash
-          inCache = true;
-          break;
+      bool inCache = passed_rom_names.count(file_rom_name) > 0; // if it's already in cache and "Passed", no need to check hash
+      if(!(inCache)){
+        if (!(dat_data.crc32_s.count(crc32))){ // CRC32 does not exist in DAT, so move file to backup folder
+          sets_backups[job].push_back({"backup", i, file_rom_name, i, file_rom_name});
+          continue;
+        } else if (crc_dupes.count(crc32) && !(dat_data.sha1_s.count(getSHA1(file_rom_name)))){ // CRC is duplicated in DAT, but SHA1 does not exist in DAT, so move file to backup folder
+          sets_backups[job].push_back({"backup", i, file_rom_name, i, file_rom_name});
+          continue;
         }
       }
-      if(!(inCache)){
-        if (!(hashInDAT(dat_path, crc32, "1"))){ // CRC32 does not exist in DAT, so move file to backup folder
-          std::string tmp_dir = tmp_path + i + "/";
-          if(!(filesys::exists(tmp_dir))){
-            filesys::create_directory(tmp_dir);
-          }
-          if(!(is_extracted)){
-            extract(folder_path+i+".zip",tmp_dir);
-            is_extracted = true;
-          }
-          if(!(filesys::exists(backup_path+i))){
-            filesys::create_directory(backup_path+i);
-          }
-          if(file_rom_name.find('/') != std::string::npos){ // if file_rom_name has slash, make that directory structure in backup dir (so that we can move the file to the correct directory)
-            filesys::path p = file_rom_name;
-            std::string parentpath = p.parent_path(); // .parent_path(): gets parent path (eg: if file_rom_name = "files/a.rom", parentpath = "files")
-            
-            if(!(filesys::exists(backup_path+i+"/"+parentpath))){
-              filesys::create_directories(backup_path+i+"/"+parentpath);
-            }
-          }          
-          
-          filesys::rename(tmp_dir+file_rom_name, backup_path+i+"/"+file_rom_name);
-          std::cout << "Moved " << file_rom_name << " in " << folder_path+i << ".zip" << " to backup folder" << std::endl;
-
-          if(!(filesys::is_empty(tmp_dir))){ // if tmp_dir is empty directory, then we don't need to zip it (since the zip only has 1 rom with non-matching CRC)
-            to_zip.insert(i);
-          }
-        } else if (std::find(dat_data.crc_dupes.begin(), dat_data.crc_dupes.end(), crc32) != dat_data.crc_dupes.end()){ // CRC is duplicated in DAT, so check SHA1
-          std::string tmp_dir = tmp_path + i + "/";
-          if(!(filesys::exists(tmp_dir))){
-            filesys::create_directory(tmp_dir);
-          }
-          if(!(is_extracted)){
-            extract(folder_path+i+".zip",tmp_dir);
-            is_extracted = true;
-          }
-
-          std::vector<std::string> hashes;
-          if(scanningWithHeaders){
-            hashes = getHashes(tmp_dir+file_rom_name, start_offset, info);
-          } else {
-            hashes = getHashes(tmp_dir+file_rom_name);
-          }
-
-          if (!(hashInDAT(dat_path, hashes[3], "2"))){ // SHA1 does not exist in DAT, so move file to backup folder
-            if(!(filesys::exists(backup_path+i))){
-              filesys::create_directory(backup_path+i);
-            }
-            if(file_rom_name.find('/') != std::string::npos){ // if file_rom_name has slash, make that directory structure in backup dir (so that we can move the file to the correct directory)
-              filesys::path p = file_rom_name;
-              std::string parentpath = p.parent_path(); // .parent_path(): gets parent path (eg: if file_rom_name = "files/a.rom", parentpath = "files")
-              
-              if(!(filesys::exists(backup_path+i+"/"+parentpath))){
-                filesys::create_directories(backup_path+i+"/"+parentpath);
-              }
-            }
-
-            filesys::rename(tmp_dir+file_rom_name, backup_path+i+"/"+file_rom_name);
-            std::cout << "Moved " << file_rom_name << " in " << folder_path+i << ".zip" << " to backup folder" << std::endl;
+      sets_zipinfo[job][file_rom_name] = crc32;
+    }
 
-            if(!(filesys::is_empty(tmp_dir))){ // if tmp_dir is empty directory, then we don't need to zip it (since the zip only has 1 rom with non-matching SHA1)
-              to_zip.insert(i);
-            }
-          }
+    if(toResolve(i, sets_zipinfo[job])){ // SHA1 is needed to work out the set and rom names of roms whose CRC is duplicated in DAT
+      for(auto j: sets_zipinfo[job]){
+        if(crc_dupes.count(j.second)){
+          getSHA1(j.first);
         }
       }
     }
-  }
+    filesys::remove_all(scratch_dir);
 
-  for(auto i: to_zip){
-    std::vector<std::string> files_to_zip = getAllFilesInDir(tmp_path+i);
-    if(filesys::exists(folder_path+i+".zip")){
-      filesys::remove(folder_path+i+".zip");
+    std::lock_guard<std::mutex> lock(bar_mutex);
+    jobindex++;
+    bar.Progressed(jobindex);
+  });
+
+  if(verify){
+    int verified = 0;
+    int corrupted = 0;
+    int mismatched = 0;
+    for(int job = 0; job < sets.size(); job++){
+      verified += sets_header_crc32[job].size();
+      corrupted += sets_corrupted[job];
+      mismatched += sets_mismatched[job];
     }
-    write_zip(folder_path+i+".zip",files_to_zip,tmp_path+i+"/","2"); // writing zip file to folder  
-    filesys::remove_all(tmp_path+i); // delete tmp dir
+    std::cout << "Verified " << verified << " rom(s): " << corrupted << " corrupted, " << mismatched << " not matching DAT (both are moved to backup folder)" << std::endl;
   }
-  filesys::remove_all(tmp_path); // delete tmp folder (in case we extracted the zip to check SHA1 but all it's SHA1s match DAT so that folder dosen't get re-zipped and removed)
-  filesys::create_directory(tmp_path); // make a new tmp folder
-
-  std::cout << "All CRC32s (now) match DAT" << std::endl;
 
-  // comparing files in folder with files in DAT; making sure all names of files in folder match DAT; unzips, renames and rezips wrongly named files
-  std::set<std::string> files_in_folder_info;
-  files_in_folder = getAllFilesInDir2(folder_path); // get list of files in folder again after moving files to backup
-  for(auto i: files_in_folder){
-    std::map<std::string, std::string> zipinfo = getInfoFromZip(folder_path+i+".zip");
-    for(auto j: zipinfo){
-      files_in_folder_info.insert("\""+i+"\" \""+j.first+"\""); // j.first = filename
+  // working out which set and rom each file belongs to; done one set at a time (in order), since roms with the same CRC32 and SHA1 are given out to sets in the order they are found
+  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string, std::string>> resolved; // set name, rom name, correct set name, correct rom name, CRC32, MD5 ("-" if not verifying), SHA1 ("-" if CRC is not duplicated in DAT and not verifying)
+  std::map<std::string, std::set<std::string>> final_names; // key is set name, value is names of roms its zip has once the plan is carried out
+  std::set<std::string> skipped;
+  for(int job = 0; job < sets.size(); job++){
+    if(sets_skipped[job]){
+      skipped.insert(sets[job]);
     }
   }
-  
-  std::set<std::string> cache_info_combined;
-  for(int i = 0; i < cache_data.set_name.size(); i++){
-    if(cache_data.status[i] == "Passed"){
-      cache_info_combined.insert("\""+cache_data.set_name[i]+"\" \""+cache_data.rom_name[i]+"\"");
+  for(int i = 0; i < cache_data.set_name.size() && !(skipped.empty()); i++){ // roms in zips that were not opened are what the cache has as "Passed" for them
+    if(cache_data.status[i] == "Passed" && skipped.count(cache_data.set_name[i])){
+      final_names[cache_data.set_name[i]].insert(cache_data.rom_name[i]);
     }
   }
-
-  std::vector<std::string> x = diff(files_in_folder_info,cache_info_combined,1); // files in folder but not in cache
-  std::set<std::string> x_set_names; // we use a set so duplicates won't get inserted
-  std::string s;
-  int counter = 0;
-  for(auto i: x){
-    std::stringstream ss(i);
-    while (ss >> std::quoted(s)){
-      if(counter % 2 == 0){
-        x_set_names.insert(s);
-      }
-      counter += 1;
+  for(int job = 0; job < sets.size(); job++){
+    std::string i = sets[job];
+    for(auto j: sets_zipinfo[job]){
+      final_names[i].insert(j.first);
+    }
+    if(!(verify) && !(toResolve(i, sets_zipinfo[job]))){ // all roms in set are already in cache (when verifying, every rom is resolved so its MD5 and SHA1 go in the cache)
+      continue;
     }
-  }
-
-  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> toAddToCache; // set name, followed by rom name, CRC32, MD5, SHA1, status
-  to_zip.clear(); // vector containing names of folders in tmp/ to zip; set so duplicates won't get inserted
-  ProgressBar bar2(x_set_names.size());
-  bar2.SetFrequencyUpdate(50);
-  jobindex = 0;
 
-  for(auto i: x_set_names){
-    jobindex++;
-    bar2.Progressed(jobindex);
+    for(auto j: sets_zipinfo[job]){
+      std::string file_rom_name = j.first;
+      std::string crc32 = j.second;
+      std::string md5 = verify ? sets_md5[job][file_rom_name] : "-";
+      std::string sha1 = verify ? sets_sha1[job][file_rom_name] : "-";
+      std::string correct_set_name;
+      std::string correct_rom_name;
 
-    // getting correct set name and rom name for file
-    std::map<std::string, std::string> zipinfo;
-    bool is_extracted = false; // whether zip file is extracted to tmp dir
-    if(scanningWithHeaders){
-      std::string tmp_dir = tmp_path + i + "/";
-      extract(folder_path+i+".zip",tmp_dir);
-      is_extracted = true;
-
-      std::vector<std::string> files = getAllFilesInDir(tmp_dir);
-      for(auto j: files){
-        std::vector<std::string> fileinfo = getHashes(j, start_offset, info);
-        std::string filename = filesys::path(j).filename();
-        zipinfo[filename] = fileinfo[1];
-      }
-    } else {
-      zipinfo = getInfoFromZip(folder_path+i+".zip");
-    }
-
-    std::string file_rom_name;
-    std::string crc32;
-    std::string correct_set_name;
-    std::string correct_rom_name;
-    bool crc32_is_duped = false; // whether CRC is duplicated in DAT
-
-    for(auto j: zipinfo){ // note: this code checks all the files in the zip if one or more files in zip isin't in cache
-      file_rom_name = j.first;
-      crc32 = j.second;
-      int index;
-      std::string sha1;
-
-      if (std::find(dat_data.crc_dupes.begin(), dat_data.crc_dupes.end(), crc32) != dat_data.crc_dupes.end()){ // if CRC is duplicated in DAT
-        crc32_is_duped = true;
-        std::string tmp_dir = tmp_path + i + "/";
-        if(!(filesys::exists(tmp_dir))){
-          filesys::create_directory(tmp_dir);
-        }
-        if(!(is_extracted)){
-          extract(folder_path+i+".zip",tmp_dir);
-          is_extracted = true;
-        }
-        std::vector<std::string> hashes;
-        if(scanningWithHeaders){
-          hashes = getHashes(tmp_dir+file_rom_name, start_offset, info);
-        } else {
-          hashes = getHashes(tmp_dir+file_rom_name);
-        }
-        sha1 = hashes[3];
+      if (crc_dupes.count(crc32)){ // if CRC is duplicated in DAT
+        sha1 = sets_sha1[job][file_rom_name];
         bool sha1_is_duped = false;
-        std::string dir_with_correct_name;
 
         for(int k = 0; k < dat_data.sha1_dupes.size(); k++){
           if(sha1 == dat_data.sha1_dupes[k]){ // both CRC and SHA1 are duplicated
@@ -561,90 +970,100 @@ void scan(std::string dat_path, std::string folder_path){
                 break;
               }
             }
-            if(correct_rom_name == "not_set"){ // file_rom_name is not in dat_data.sha1_dupes_rom_names[k]
+            if(correct_rom_name == "not_set" && !(dat_data.sha1_dupes_rom_names[k].empty())){ // file_rom_name is not in dat_data.sha1_dupes_rom_names[k]
               correct_rom_name = dat_data.sha1_dupes_rom_names[k][0]; // set correct rom name to be first element
               correct_set_name = dat_data.sha1_dupes_set_names[k][0]; // set correct set name to be first element
               dat_data.sha1_dupes_rom_names[k].erase(dat_data.sha1_dupes_rom_names[k].begin()+0); // remove dat_data.sha1_dupes_rom_names[k][0]
               dat_data.sha1_dupes_set_names[k].erase(dat_data.sha1_dupes_set_names[k].begin()+0); // remove dat_data.sha1_dupes_set_names[k][0]
+            } else if (correct_rom_name == "not_set"){ // every set that has this rom already has it
+              correct_rom_name = "";
             }
             break;
           }
         }
 
         if(!(sha1_is_duped)){ // CRC is duplicated but SHA1 is not
-          std::tuple<std::string, std::string> names = getNameFromHash(dat_path, sha1, "2");
+          std::tuple<std::string, std::string> names = getNames(first_with_sha1, sha1);
           correct_set_name = std::get<0>(names);
           correct_rom_name = std::get<1>(names);
         }
-
-        dir_with_correct_name = tmp_path+correct_set_name+"/";
-        if(dir_with_correct_name != i){ // if the set is named incorrectly
-          if(!(filesys::exists(dir_with_correct_name))){
-            filesys::rename(tmp_dir,dir_with_correct_name); // rename tmp_dir's foldername to correct_set_name so we don't extract the zip twice
-          } else {
-            filesys::rename(tmp_dir+file_rom_name,dir_with_correct_name+file_rom_name); // move the rom to correct_set_name
-          }
-        }
       } else { // neither CRC nor SHA1 are duplicated
-        std::tuple<std::string, std::string> names = getNameFromHash(dat_path, crc32, "1");
+        std::tuple<std::string, std::string> names = getNames(first_with_crc32, crc32);
         correct_set_name = std::get<0>(names);
         correct_rom_name = std::get<1>(names);
       }
+      resolved.push_back(std::make_tuple(i, file_rom_name, correct_set_name, correct_rom_name, crc32, md5, sha1));
+    }
+  }
 
-      if(!(i == correct_set_name && file_rom_name == correct_rom_name)) { // if filename or setname is incorrect
-        std::string tmp_dir = tmp_path + correct_set_name + "/"; // we use correct_set_name as other files in other zips could belong to that set; so we'd want it moved there
-        if(!(filesys::exists(tmp_dir))){
-          filesys::create_directory(tmp_dir); // create tmp dir if not present
-        }
-        if(!(is_extracted)){
-          extract(folder_path+i+".zip",tmp_dir); // extract file to tmp dir
-          filesys::remove(folder_path+i+".zip"); // remove file
-          is_extracted = true;
-        }
-        if(correct_rom_name.find('/') != std::string::npos){ // if correct_rom_name has slash, make that directory structure in tmp dir (so that we can move the file to the correct directory)
-          filesys::path p = correct_rom_name;
-          std::string parentpath = p.parent_path(); // .parent_path(): gets parent path (eg: if correct_rom_name = "files/a.rom", parentpath = "files")
-          
-          if(!(filesys::exists(tmp_dir+parentpath))){
-            filesys::create_directories(tmp_dir+parentpath);
-          }
-        }
-        
-        filesys::rename(tmp_dir+file_rom_name,tmp_dir+correct_rom_name); // rename file to correct name (and move file to correct location)
-        std::cout << "Renamed " << file_rom_name << " to " << correct_rom_name << std::endl;
+  // making the plan; a rom that would take the name of another rom in the same set is moved to backup folder instead of replacing it
+  std::vector<scanAction> plan;
+  std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>> toAddToCache; // set name, followed by rom name, CRC32, MD5, SHA1, status
+  for(auto i: sets_backups){
+    plan.insert(plan.end(), i.begin(), i.end());
+  }
+  for(auto i: resolved){
+    if(std::get<0>(i) != std::get<2>(i) || std::get<1>(i) != std::get<3>(i)){ // rom is leaving its place
+      final_names[std::get<0>(i)].erase(std::get<1>(i));
+    }
+  }
+  for(auto i: resolved){
+    std::string set_name = std::get<0>(i);
+    std::string rom_name = std::get<1>(i);
+    std::string correct_set_name = std::get<2>(i);
+    std::string correct_rom_name = std::get<3>(i);
+
+    if(correct_set_name.empty() || correct_rom_name.empty() || (!(set_name == correct_set_name && rom_name == correct_rom_name) && final_names[correct_set_name].count(correct_rom_name))){ // not in DAT (only checked by name before), or the set already has a rom with that name
+      plan.push_back({"backup", set_name, rom_name, set_name, rom_name});
+      continue;
+    }
+    if(set_name == correct_set_name && rom_name != correct_rom_name){
+      plan.push_back({"rename", set_name, rom_name, correct_set_name, correct_rom_name});
+    } else if (set_name != correct_set_name){
+      plan.push_back({"move", set_name, rom_name, correct_set_name, correct_rom_name});
+    }
+    final_names[correct_set_name].insert(correct_rom_name);
+    toAddToCache.push_back(std::make_tuple(correct_set_name, correct_rom_name, std::get<4>(i), std::get<5>(i), std::get<6>(i), "Passed")); // MD5 and SHA1 are only there if they were checked
+  }
 
-        if(filesys::exists(folder_path+correct_set_name+".zip")){ // if existing file exists
-          extract(folder_path+correct_set_name+".zip",tmp_dir); // extract file to tmp dir
-          filesys::remove(folder_path+correct_set_name+".zip"); // remove file
-        }
+  if(dry_run){
+    for(auto i: plan){
+      std::cout << describeAction(i, folder_path, containers, false) << std::endl;
+    }
+    std::cout << plan.size() << " change(s) needed; nothing was changed (dry run)" << std::endl;
+    std::cout << std::endl;
+    printCount(countSetsRoms(cache_data));
+    return;
+  }
 
-        removeEmptyDirs(tmp_dir); // needed because e.g. if we move tmp_dir/a/Asteroids.a52 -> tmp_dir/files/Asteroids.a52 (correct location), we still need to get rid of the empty folder tmp_dir/a so it won't get zipped (if we move tmp_dir/files/AsteroidsWrongName.a52 -> tmp_dir/files/Asteroids.a52, then there's no need to remove any folder)
+  // carrying out the plan
+  executePlan(folder_path, plan, sorted);
+  for(auto i: plan){
+    std::cout << describeAction(i, folder_path, containers, true) << std::endl;
+  }
+  clearTmpFolder(); // empty tmp folder, keeping what a rebuild that was stopped left in it
 
-        to_zip.insert(correct_set_name);
-      }
+  std::cout << "All CRC32s, set and rom names (now) match DAT" << std::endl;
 
-      if(!(crc32_is_duped)){
-        toAddToCache.push_back(std::make_tuple(correct_set_name, correct_rom_name, crc32, "-", "-", "Passed"));
-      } else {
-        toAddToCache.push_back(std::make_tuple(correct_set_name, correct_rom_name, crc32, "-", sha1, "Passed")); // SHA1 was checked so we reflect that in cache
-      }
+  // roms of sets that were there at the last scan but not anymore are missing
+  std::set<std::string> removed;
+  for(auto i: zip_stats){
+    if(!(containers.count(i.first))){
+      removed.insert(i.first);
+      std::cout << folder_path << i.first << " was removed since last scan" << std::endl;
     }
   }
-  for(auto i: to_zip){
-    std::vector<std::string> files_to_zip = getAllFilesInDir(tmp_path+i);
-    write_zip(folder_path+i+".zip",files_to_zip,tmp_path+i+"/","2"); // writing zip file to folder  
-    filesys::remove_all(tmp_path+i); // delete tmp dir
+  for(int i = 0; i < cache_data.set_name.size() && !(removed.empty()); i++){
+    if(cache_data.status[i] == "Passed" && removed.count(cache_data.set_name[i])){
+      toAddToCache.push_back(std::make_tuple(cache_data.set_name[i], cache_data.rom_name[i], cache_data.crc32[i], cache_data.md5[i], cache_data.sha1[i], "Missing"));
+    }
   }
-  filesys::remove_all(tmp_path); // delete tmp folder (in case we extracted the zip to check SHA1 but all it's roms are named correctly so that folder dosen't get re-zipped and removed)
-  filesys::create_directory(tmp_path); // make a new tmp folder
-
-  std::cout << "All set and rom names (now) match DAT" << std::endl;
 
   // adding new entries to cache
   cache_data = addToCache(dat_path,toAddToCache);
 
   // comparing cache with DAT; gets entries in DAT but not in cache, writes "Missing" entries to cache
-  toAddToCache = getMissing(dat_path, cache_data);
+  toAddToCache = getMissing(dat_data, cache_data);
 
   // adding new entries to cache
   cache_data = addToCache(dat_path,toAddToCache);
@@ -655,6 +1074,39 @@ void scan(std::string dat_path, std::string folder_path){
   // update cache with set/rom count
   updateCacheCount(dat_path, cache_path, folder_path, count);
 
+  // record zip stats (after the cache is written), so the next quick scan only opens zips that changed
+  std::map<std::string, std::tuple<std::string, std::string, std::string>> new_zip_stats;
+  for(int i = 0; i < sets.size(); i++){
+    new_zip_stats[sets[i]] = sets_stat[i];
+  }
+  std::set<std::string> planned; // sets changed by the plan
+  for(auto &i: plan){
+    planned.insert(i.set_name);
+    planned.insert(i.new_set_name);
+  }
+  zip_stats.clear();
+  for(auto &i: getSetContainers(folder_path)){
+    auto it = new_zip_stats.find(i.first);
+    if(!(changed_sets.empty()) && !(changed_sets.count(i.first)) && !(planned.count(i.first)) && it != new_zip_stats.end()){ // not looked at
+      zip_stats[i.first] = it->second;
+      continue;
+    }
+    std::tuple<std::string, std::string> zip_stat = getContainerStat(i.second);
+    if(it != new_zip_stats.end() && std::get<0>(it->second) == std::get<0>(zip_stat) && std::get<1>(it->second) == std::get<1>(zip_stat)){
+      zip_stats[i.first] = it->second;
+    } else { // set was changed by the plan (or is new)
+      zip_stats[i.first] = std::make_tuple(std::get<0>(zip_stat), std::get<1>(zip_stat), getContainerListingCRC32(i.second));
+    }
+  }
+  writeZipStats(dat_path, zip_stats);
+
+  // update hash store with what this DAT wants and where we have it
+  if(update_store){
+    hashStore store = getHashStore();
+    updateHashStore(store, dat_path, folder_path, dat_data, cache_data);
+    writeHashStore(store);
+  }
+
   std::cout << std::endl;
   printCount(count);
 }
\ No newline at end of file
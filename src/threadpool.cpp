@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <functional>
+
+#include <threadpool.h>
+
+/*
+ * Gets the number of worker threads to use
+ *
+ * Returns:
+ *     no_of_workers : Number of hardware threads (at least 1)
+ */
+int getNoOfWorkers(){
+  int no_of_workers = std::thread::hardware_concurrency();
+  if(no_of_workers < 1){ // hardware_concurrency() returns 0 if it can't tell
+    no_of_workers = 1;
+  }
+  return no_of_workers;
+}
+
+/*
+ * Runs jobs 0 to no_of_jobs-1 across worker threads, and returns once all of them are done
+ *
+ * Arguments:
+ *     no_of_jobs : Number of jobs
+ *     run_job : Function called with the job number and the number of the worker (0 to getNoOfWorkers()-1) running it. Each worker runs one job at a time, so the worker number can be used to give each job a scratch directory that no running job shares
+ *
+ * Notes:
+ *     Idle workers take the next job that hasn't been started, so a few slow jobs (e.g. big sets) don't hold up the rest
+ *     If a job throws, the remaining jobs are not started and the exception is rethrown once running jobs are done
+ */
+void parallelFor(int no_of_jobs, std::function<void(int job, int worker)> run_job){
+  int no_of_workers = std::min(getNoOfWorkers(), no_of_jobs);
+  if(no_of_workers <= 1){ // no point starting threads
+    for(int i = 0; i < no_of_jobs; i++){
+      run_job(i, 0);
+    }
+    return;
+  }
+
+  std::atomic<int> next_job(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::vector<std::thread> workers;
+
+  for(int worker = 0; worker < no_of_workers; worker++){
+    workers.emplace_back([&, worker](){
+      int job;
+      while(!(failed) && (job = next_job++) < no_of_jobs){
+        try {
+          run_job(job, worker);
+        } catch (...) {
+          if(!(failed.exchange(true))){ // only keep the first exception
+            error = std::current_exception();
+          }
+        }
+      }
+    });
+  }
+  for(auto &i: workers){
+    i.join();
+  }
+
+  if(error){
+    std::rethrow_exception(error);
+  }
+}
+
+/*
+ * Runs jobs in queues, each queue with its own share of the worker threads, and returns once all of them are done
+ *
+ * Arguments:
+ *     queues : Vector of queues, each a vector of job numbers; a queue's workers take its jobs in order
+ *     run_job : Function called with the job number and the number of the worker running it. Workers are numbered across all queues, so as in parallelFor(), no two running jobs share a worker number
+ *
+ * Notes:
+ *     Used when jobs have to be spread by something other than CPU, e.g. one queue per disk, so one busy disk doesn't hold up the others
+ *     Worker threads (see getNoOfWorkers()) are split between queues, with at least one per queue, and no queue gets more workers than it has jobs; so as many workers run as with parallelFor(), and with a single queue this is the same as parallelFor()
+ *     If a job throws, the remaining jobs are not started and the exception is rethrown once running jobs are done
+ */
+void parallelForQueues(const std::vector<std::vector<int>> &queues, std::function<void(int job, int worker)> run_job){
+  std::vector<int> queue_workers(queues.size()); // no. of workers each queue gets
+  int no_of_workers = 0;
+  for(int i = 0; i < queues.size(); i++){ // every queue with jobs gets a worker, even if there are more queues than worker threads
+    queue_workers[i] = !(queues[i].empty());
+    no_of_workers += queue_workers[i];
+  }
+  for(bool added = true; added && no_of_workers < getNoOfWorkers();){ // the rest are handed out one at a time to queues with more jobs than workers
+    added = false;
+    for(int i = 0; i < queues.size() && no_of_workers < getNoOfWorkers(); i++){
+      if(queue_workers[i] < queues[i].size()){
+        queue_workers[i]++;
+        no_of_workers++;
+        added = true;
+      }
+    }
+  }
+  if(no_of_workers <= 1){ // no point starting threads
+    for(auto &i: queues){
+      for(int job: i){
+        run_job(job, 0);
+      }
+    }
+    return;
+  }
+
+  std::vector<std::atomic<int>> next_job(queues.size()); // index of the next job to be started in each queue
+  for(auto &i: next_job){
+    i = 0;
+  }
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::vector<std::thread> workers;
+
+  for(int queue = 0; queue < queues.size(); queue++){
+    for(int k = 0; k < queue_workers[queue]; k++){
+      int worker = workers.size();
+      workers.emplace_back([&, queue, worker](){
+        const std::vector<int> &jobs = queues[queue];
+        int job;
+        while(!(failed) && (job = next_job[queue]++) < jobs.size()){
+          try {
+            run_job(jobs[job], worker);
+          } catch (...) {
+            if(!(failed.exchange(true))){ // only keep the first exception
+              error = std::current_exception();
+            }
+          }
+        }
+      });
+    }
+  }
+  for(auto &i: workers){
+    i.join();
+  }
+
+  if(error){
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <paths.h>
+#include <cache.h>
+#include <scanner.h>
+#include <rebuilder.h>
+#include <watcher.h>
+
+namespace filesys = std::filesystem;
+
+const uint32_t watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO; // files written, added, removed or renamed
+const int quiet_ms = 2000; // changes are handled once there has been no event for this long
+const int max_wait_ms = 30000; // or once events have kept coming for this long
+
+/*
+ * Checks whether a folder is one of the rebuild folders
+ *
+ * Arguments:
+ *     root : Path to folder (*Path must end with a forward slash)
+ *
+ * Returns:
+ *     true if root is in rebuild_paths, false otherwise
+ */
+bool isRebuildPath(std::string root){
+  return std::find(rebuild_paths.begin(), rebuild_paths.end(), root) != rebuild_paths.end();
+}
+
+/*
+ * Watches a folder and its subfolders with inotify
+ *
+ * Arguments:
+ *     fd : inotify file descriptor
+ *     path : Path to folder (*Path must end with a forward slash)
+ *     root : Romset folder or rebuild folder that path is in (*Path must end with a forward slash)
+ *     set_name : Name of set that path is (or is in) the directory of; "" if path is root or in a rebuild folder
+ *     watches : Map with key as watch descriptor, value as path, root and set name of the folder watched
+ */
+void addWatch(int fd, std::string path, std::string root, std::string set_name, std::map<int, std::tuple<std::string, std::string, std::string>> &watches){
+  int wd = inotify_add_watch(fd, path.c_str(), watch_mask);
+  if(wd < 0){
+    std::cout << "Could not watch " << path << std::endl;
+    return;
+  }
+  watches[wd] = std::make_tuple(path, root, set_name);
+
+  std::error_code ec;
+  for(auto &i: filesys::directory_iterator(path, ec)){
+    if(i.is_directory(ec)){
+      std::string child_set_name = set_name;
+      if(path == root && !(isRebuildPath(root))){ // a directory in a romset folder is a set (see getSetContainers())
+        child_set_name = i.path().filename().string();
+      }
+      addWatch(fd, i.path().string() + "/", root, child_set_name, watches);
+    }
+  }
+}
+
+/*
+ * Watches romsets and the rebuild folders, and keeps caches up to date as files change: sets that change are rescanned, and files added to a rebuild folder are rebuilt. Runs until stopped (e.g. with Ctrl+C).
+ *
+ * Arguments:
+ *     profiles : Vector of tuples containing DAT path and romset folder path (*Path must end with a forward slash) of each profile
+ *
+ * Notes:
+ *     Each romset is quick scanned first (see scan()). After that, only sets that had files written, added, removed or renamed are looked at (see changed_sets in scan()).
+ *     Events are debounced: they are handled once none have come for a while, so a set being copied in is only scanned once it is all there
+ *     Changes made while fixing sets are seen as well; rescanning those sets is cheap, as the scan that made them recorded their size and modification time
+ *     As with batch scanning, the rebuilder does not remove files from the rebuild folder that are rebuilt; its own changes there (deleting files that are not needed) are not acted on
+ */
+void watch(std::vector<std::tuple<std::string, std::string>> profiles){
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(fd < 0){
+    std::cout << "Could not start inotify!" << std::endl;
+    exit(0);
+  }
+
+  for(auto i: profiles){
+    scan(std::get<0>(i), std::get<1>(i), false, true);
+  }
+
+  std::map<int, std::tuple<std::string, std::string, std::string>> watches; // key is watch descriptor, value is path, romset folder (or rebuild folder) and set name of the folder watched
+  std::set<std::string> folders; // romset folders
+  for(auto i: profiles){
+    if(folders.insert(std::get<1>(i)).second){
+      addWatch(fd, std::get<1>(i), std::get<1>(i), "", watches);
+    }
+  }
+  for(auto i: rebuild_paths){
+    addWatch(fd, i, i, "", watches);
+  }
+  std::cout << "Watching " << folders.size() << " romset(s) and " << rebuild_paths.size() << " rebuild folder(s) (Ctrl+C to stop)" << std::endl;
+
+  std::map<std::string, std::set<std::string>> changed; // key is romset folder, value is names of sets that changed
+  std::set<std::string> rescan_all; // romset folders whose events were lost (inotify queue overflowed)
+  bool to_rebuild = false;
+  auto readEvents = [&](bool rebuild_events){ // reads all events that are waiting; events in the rebuild folder are dropped if rebuild_events is false
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len;
+    while((len = read(fd, buf, sizeof(buf))) > 0){
+      for(char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len){
+        struct inotify_event *event = (struct inotify_event *)p;
+        if(event->mask & IN_Q_OVERFLOW){
+          rescan_all.insert(folders.begin(), folders.end());
+          to_rebuild = to_rebuild || rebuild_events;
+          continue;
+        }
+        auto it = watches.find(event->wd);
+        if(it == watches.end()){
+          continue;
+        }
+        if(event->mask & IN_IGNORED){ // folder was removed
+          watches.erase(it);
+          continue;
+        }
+        std::string path = std::get<0>(it->second);
+        std::string root = std::get<1>(it->second);
+        std::string set_name = std::get<2>(it->second);
+        std::string name = event->len ? event->name : "";
+        bool new_dir = (event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO));
+
+        if(isRebuildPath(root)){
+          if(rebuild_events){
+            to_rebuild = true;
+            if(new_dir){ // files in new folders are rebuilt too
+              addWatch(fd, path + name + "/", root, "", watches);
+            }
+          }
+          continue;
+        }
+
+        if(path == root){ // name is a zip, 7z, directory or file of a set
+          filesys::path file_path = name;
+          if(file_path.extension() == ".new" || file_path.extension() == ".tmp"){ // written while fixing a set; it is renamed to the set once done
+            continue;
+          }
+          set_name = (event->mask & IN_ISDIR) ? name : file_path.stem().string();
+        }
+        if(new_dir){
+          addWatch(fd, path + name + "/", root, set_name, watches);
+        }
+        changed[root].insert(set_name);
+      }
+    }
+  };
+
+  struct pollfd pfd = {fd, POLLIN, 0};
+  while(true){
+    if(poll(&pfd, 1, -1) <= 0){ // wait for something to change
+      continue;
+    }
+    readEvents(true);
+    auto first_event = std::chrono::steady_clock::now();
+    while(poll(&pfd, 1, quiet_ms) > 0){ // wait for changes to settle
+      readEvents(true);
+      if(std::chrono::steady_clock::now() - first_event > std::chrono::milliseconds(max_wait_ms)){
+        break;
+      }
+    }
+
+    if(to_rebuild){
+      to_rebuild = false;
+      rebuild(profiles, false); // false so rebuild folder won't get deleted; files are hashed once for all profiles
+      readEvents(false); // drop events from files deleted in rebuild folder; romsets changed by the rebuilder are rescanned below
+    }
+
+    std::map<std::string, std::set<std::string>> to_scan;
+    to_scan.swap(changed);
+    std::set<std::string> to_scan_all;
+    to_scan_all.swap(rescan_all);
+    for(auto i: profiles){
+      std::string folder_path = std::get<1>(i);
+      if(to_scan_all.count(folder_path)){
+        scan(std::get<0>(i), folder_path, false, true);
+      } else if (to_scan.count(folder_path)){
+        std::cout << to_scan[folder_path].size() << " set(s) changed in " << folder_path << std::endl;
+        scan(std::get<0>(i), folder_path, false, true, false, to_scan[folder_path]);
+      }
+    }
+  }
+}
@@ -0,0 +1,416 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <filesystem>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include "/usr/include/archive.h"
+#include <archive_entry.h>
+
+#include <gethashes.h>
+#include <workspace.h>
+
+namespace filesys = std::filesystem;
+
+/*
+ * Sets last modification time of a file
+ */
+void setMtime(std::string path, time_t mtime){
+  struct utimbuf times;
+  times.actime = mtime;
+  times.modtime = mtime;
+  utime(path.c_str(), &times);
+}
+
+/*
+ * Moves a file, copying it if it can't be renamed (e.g. it is on another filesystem)
+ */
+void moveFile(std::string from, std::string to){
+  std::error_code ec;
+  filesys::rename(from, to, ec);
+  if(ec){
+    struct stat st;
+    stat(from.c_str(), &st);
+    filesys::copy_file(from, to, filesys::copy_options::overwrite_existing);
+    setMtime(to, st.st_mtime);
+    filesys::remove(from);
+  }
+}
+
+/*
+ * Makes a copy of a file that shares its data where the filesystem allows it, so a file needed in many places costs metadata only
+ *
+ * Arguments:
+ *     from : Path to file
+ *     to : Path of copy (must not exist)
+ *
+ * Notes:
+ *     Tries a reflink first (FICLONE, e.g. on btrfs/XFS), so the copy is still a file of its own; then a hard link; then a plain copy
+ *     Hard links share the file itself, so this is only for files that are not changed in place (e.g. roms in tmp dir waiting to be added to sets)
+ */
+void cloneFile(std::string from, std::string to){
+#ifdef FICLONE
+  int src = open(from.c_str(), O_RDONLY);
+  if(src >= 0){
+    int dst = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if(dst >= 0){
+      bool cloned = ioctl(dst, FICLONE, src) == 0;
+      close(dst);
+      if(!(cloned)){
+        filesys::remove(to);
+      }
+      close(src);
+      if(cloned){
+        struct stat st;
+        stat(from.c_str(), &st);
+        setMtime(to, st.st_mtime);
+        return;
+      }
+    } else {
+      close(src);
+    }
+  }
+#endif
+  std::error_code ec;
+  filesys::create_hard_link(from, to, ec);
+  if(ec){
+    filesys::copy_file(from, to);
+  }
+}
+
+/*
+ * Starts an empty workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     spill_dir : Directory that files are written to once more than spill_threshold bytes are held in memory (*Path must end with a forward slash); it is only made when needed
+ *     spill_threshold (Optional) : Number of bytes that can be held in memory
+ */
+void initWorkspace(workspace &ws, std::string spill_dir, unsigned long long spill_threshold){
+  ws.entries.clear();
+  ws.spill_dir = spill_dir;
+  ws.spill_threshold = spill_threshold;
+  ws.in_memory = 0;
+  ws.spilled = 0;
+}
+
+/*
+ * Gets a path in spill_dir for a new file
+ */
+std::string newSpillPath(workspace &ws){
+  filesys::create_directories(ws.spill_dir);
+  return ws.spill_dir + std::to_string(ws.spilled++);
+}
+
+/*
+ * Removes a file from a workspace (if it is there)
+ */
+void removeFromWorkspace(workspace &ws, std::string name){
+  auto it = ws.entries.find(name);
+  if(it == ws.entries.end()){
+    return;
+  }
+  if(it->second.path.empty()){
+    ws.in_memory -= it->second.size;
+  } else {
+    filesys::remove(it->second.path);
+  }
+  ws.entries.erase(it);
+}
+
+/*
+ * Puts a file in a workspace, replacing any file with the same name; a file held in memory is written to spill_dir if there is no room for it
+ */
+void storeInWorkspace(workspace &ws, std::string name, workspaceEntry file){
+  removeFromWorkspace(ws, name);
+  if(file.path.empty() && ws.in_memory + file.size > ws.spill_threshold){
+    file.path = newSpillPath(ws);
+    std::ofstream out(file.path, std::ios::binary);
+    out.write(file.data.data(), file.data.size());
+    out.close();
+    setMtime(file.path, file.mtime);
+    std::string().swap(file.data); // free memory
+  }
+  if(file.path.empty()){
+    ws.in_memory += file.size;
+  }
+  ws.entries[name] = std::move(file);
+}
+
+/*
+ * Extracts files from an archive (e.g. zip/7z) into a workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     filename : Path to archive
+ *     names (Optional) : Names of files to extract; if not empty, other files are skipped
+ *
+ * Returns:
+ *     true if the archive was read, false if it could not be opened
+ *
+ * Notes:
+ *     Files already in the workspace with the same name as a file in the archive are replaced
+ *     As extract(), directories are not kept and files whose data is corrupted are left out
+ */
+bool extractToWorkspace(workspace &ws, std::string filename, const std::set<std::string> &names){
+  struct archive *a;
+  struct archive_entry *entry;
+
+  int resume = 0; // index of file to carry on from when the archive is reopened
+  for (bool reopen = true; reopen;) {
+    reopen = false;
+    a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+    if (archive_read_open_filename(a, filename.c_str(), 102400) != ARCHIVE_OK) {
+      archive_read_free(a);
+      return false;
+    }
+
+    int r;
+    for (int index = 0; (r = archive_read_next_header(a, &entry)) == ARCHIVE_OK || r == ARCHIVE_WARN; index++) {
+      if (index < resume || archive_entry_filetype(entry) == AE_IFDIR || (!(names.empty()) && !(names.count(archive_entry_pathname(entry))))) {
+        archive_read_data_skip(a);
+        continue;
+      }
+
+      workspaceEntry file;
+      file.size = 0;
+      file.mtime = archive_entry_mtime(entry);
+      std::ofstream out;
+      if (archive_entry_size_is_set(entry) && ws.in_memory + archive_entry_size(entry) > ws.spill_threshold) { // too big to hold in memory, so write it to spill_dir as it is decompressed
+        file.path = newSpillPath(ws);
+        out.open(file.path, std::ios::binary);
+      }
+
+      const void *buff;
+      size_t size;
+      la_int64_t offset;
+      while ((r = archive_read_data_block(a, &buff, &size, &offset)) == ARCHIVE_OK) {
+        if (file.path.empty()) {
+          file.data.append(static_cast<const char *>(buff), size);
+        } else {
+          out.write(static_cast<const char *>(buff), size);
+        }
+        file.size += size;
+      }
+      out.close();
+
+      std::string name = archive_entry_pathname(entry);
+      if (r != ARCHIVE_EOF) { // data is corrupted, so the file is left out
+        std::cerr << filename << ": " << name << ": " << archive_error_string(a) << std::endl;
+        if (!(file.path.empty())) {
+          filesys::remove(file.path);
+        }
+        if (r == ARCHIVE_FATAL) { // archive can't be read any further, so reopen it and carry on from the next file
+          resume = index + 1;
+          reopen = true;
+          break;
+        }
+        continue;
+      }
+      if (!(file.path.empty())) {
+        setMtime(file.path, file.mtime);
+      }
+      storeInWorkspace(ws, name, std::move(file));
+    }
+    archive_read_free(a);
+  }
+  return true;
+}
+
+/*
+ * Adds a file on disk to a workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     path : Path to file
+ *     name : Name of file in workspace
+ *     keep (Optional) : true to copy the file, false to move it (it is removed from disk once it is read into memory)
+ *
+ * Returns:
+ *     true if the file was added, false if it does not exist
+ */
+bool addFileToWorkspace(workspace &ws, std::string path, std::string name, bool keep){
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0){
+    return false;
+  }
+
+  workspaceEntry file;
+  file.size = st.st_size;
+  file.mtime = st.st_mtime;
+  removeFromWorkspace(ws, name);
+  if(ws.in_memory + file.size > ws.spill_threshold){
+    file.path = newSpillPath(ws);
+    if(keep){
+      filesys::copy_file(path, file.path, filesys::copy_options::overwrite_existing);
+      setMtime(file.path, file.mtime);
+    } else {
+      moveFile(path, file.path);
+    }
+  } else {
+    std::ifstream in(path, std::ios::binary);
+    file.data.resize(file.size);
+    in.read(&file.data[0], file.size);
+    in.close();
+    if(!(keep)){
+      filesys::remove(path);
+    }
+  }
+  storeInWorkspace(ws, name, std::move(file));
+  return true;
+}
+
+/*
+ * Renames a file in a workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     name : Name of file
+ *     new_name : New name of file
+ *
+ * Returns:
+ *     true if the file was renamed, false if it is not in the workspace or a file named new_name already is
+ */
+bool renameInWorkspace(workspace &ws, std::string name, std::string new_name){
+  if(!(ws.entries.count(name)) || ws.entries.count(new_name)){
+    return false;
+  }
+  auto node = ws.entries.extract(name);
+  node.key() = new_name;
+  ws.entries.insert(std::move(node));
+  return true;
+}
+
+/*
+ * Moves a file from one workspace to another (replacing any file with the same name there)
+ *
+ * Arguments:
+ *     from : Workspace that has the file (see definition in workspace.h)
+ *     name : Name of file in from
+ *     to : Workspace to move the file to
+ *     new_name : Name of file in to
+ *
+ * Returns:
+ *     true if the file was moved, false if it is not in from
+ */
+bool moveToWorkspace(workspace &from, std::string name, workspace &to, std::string new_name){
+  if(&from == &to){
+    return name == new_name ? from.entries.count(name) > 0 : renameInWorkspace(from, name, new_name);
+  }
+  auto it = from.entries.find(name);
+  if(it == from.entries.end()){
+    return false;
+  }
+
+  workspaceEntry file = std::move(it->second);
+  from.entries.erase(it);
+  if(file.path.empty()){
+    from.in_memory -= file.size;
+  } else { // move it to to's spill_dir, so it is removed with the rest of to's files
+    std::string path = newSpillPath(to);
+    moveFile(file.path, path);
+    file.path = path;
+  }
+  storeInWorkspace(to, new_name, std::move(file));
+  return true;
+}
+
+/*
+ * Writes a file in a workspace to disk, and removes it from the workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     name : Name of file
+ *     path : Path to write the file to; directories in it are made if needed
+ *
+ * Returns:
+ *     true if the file was written, false if it is not in the workspace
+ */
+bool writeFromWorkspace(workspace &ws, std::string name, std::string path){
+  auto it = ws.entries.find(name);
+  if(it == ws.entries.end()){
+    return false;
+  }
+
+  if(filesys::path(path).has_parent_path()){
+    filesys::create_directories(filesys::path(path).parent_path());
+  }
+  if(it->second.path.empty()){
+    std::ofstream out(path, std::ios::binary);
+    out.write(it->second.data.data(), it->second.data.size());
+    out.close();
+    setMtime(path, it->second.mtime);
+    ws.in_memory -= it->second.size;
+  } else {
+    moveFile(it->second.path, path);
+  }
+  ws.entries.erase(it);
+  return true;
+}
+
+/*
+ * Writes all files in a workspace to a directory (with their names as paths relative to it), and empties the workspace
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     dir : Path to directory (*Path must end with a forward slash)
+ */
+void writeWorkspaceToDir(workspace &ws, std::string dir){
+  std::vector<std::string> names;
+  for(auto &i: ws.entries){
+    names.push_back(i.first);
+  }
+  for(auto i: names){
+    writeFromWorkspace(ws, i, dir + i);
+  }
+}
+
+/*
+ * Calculates CRC32, MD5 and SHA1 of a file in a workspace; see getHashes()
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ *     name : Name of file
+ *     start_offset (Optional) : Offset to start calculating hash from (in decimal)
+ *     data (Optional) : Vector of tuples containing offset (in decimal) and their expected values (in lowercase)
+ *
+ * Returns:
+ *     output : Vector containing file size, CRC32, MD5, SHA1 of the file (in that order); empty if the file is not in the workspace
+ */
+std::vector<std::string> hashInWorkspace(const workspace &ws, std::string name, int start_offset, std::vector<std::tuple<int, std::string>> data){
+  auto it = ws.entries.find(name);
+  if(it == ws.entries.end()){
+    return {};
+  }
+  if(!(it->second.path.empty())){
+    return getHashes(it->second.path, start_offset, data);
+  }
+
+  hashState state;
+  initHashes(state, start_offset, data);
+  updateHashes(state, it->second.data.data(), it->second.data.size());
+  return finishHashes(state);
+}
+
+/*
+ * Empties a workspace, removing its files in spill_dir
+ *
+ * Arguments:
+ *     ws : Workspace (see definition in workspace.h)
+ */
+void clearWorkspace(workspace &ws){
+  for(auto &i: ws.entries){
+    if(!(i.second.path.empty())){
+      filesys::remove(i.second.path);
+    }
+  }
+  ws.entries.clear();
+  ws.in_memory = 0;
+}
@@ -0,0 +1,684 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <sys/stat.h>
+
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "../libs/zip/src/miniz.h"
+
+#include <workspace.h>
+#include <zipedit.h>
+
+namespace filesys = std::filesystem;
+
+/*
+ * zipEntry
+ *
+ * central_header: central directory record of the entry as it is in the zip, without its name (fixed size part, followed by extra field and comment)
+ * name: name of the entry
+ * flags: general purpose bit flag
+ * comp_size: compressed size
+ * local_header_ofs: offset of the entry's local header in the zip
+ */
+struct zipEntry {
+  std::string central_header;
+  std::string name;
+  unsigned int flags;
+  unsigned int comp_size;
+  unsigned int local_header_ofs;
+};
+
+unsigned int readLE16(const char *p){
+  return (unsigned char)p[0] | ((unsigned char)p[1] << 8);
+}
+
+unsigned int readLE32(const char *p){
+  return readLE16(p) | (readLE16(p + 2) << 16);
+}
+
+void writeLE16(char *p, unsigned int value){
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+}
+
+void writeLE32(char *p, unsigned int value){
+  writeLE16(p, value & 0xFFFF);
+  writeLE16(p + 2, value >> 16);
+}
+
+/*
+ * Reads the central directory of a zip file
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *     entries : Vector that the entries in the zip are put in (in the order they are in the central directory)
+ *
+ * Returns:
+ *     true if the central directory was read, false if the zip could not be read or needs zip64
+ *
+ * Notes:
+ *     Zips are opened with miniz (libs/zip) first, to validate them and find the central directory
+ */
+bool readCentralDir(std::string zip_path, std::vector<zipEntry> &entries){
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if(!(mz_zip_reader_init_file(&zip, zip_path.c_str(), 0))){
+    return false;
+  }
+  unsigned long long central_dir_ofs = zip.m_central_directory_file_ofs;
+  unsigned int no_of_entries = zip.m_total_files;
+  mz_zip_reader_end(&zip);
+
+  if(no_of_entries >= 0xFFFF || central_dir_ofs >= 0xFFFFFFFF){ // would need zip64
+    return false;
+  }
+
+  std::ifstream in(zip_path, std::ios::binary);
+  in.seekg(central_dir_ofs);
+  entries.resize(no_of_entries);
+  char header[46];
+
+  for(auto &i: entries){
+    if(!(in.read(header, 46)) || readLE32(header) != 0x02014b50){ // central directory file header signature
+      return false;
+    }
+    unsigned int name_len = readLE16(header + 28);
+    unsigned int extra_len = readLE16(header + 30);
+    unsigned int comment_len = readLE16(header + 32);
+    i.flags = readLE16(header + 8);
+    i.comp_size = readLE32(header + 20);
+    i.local_header_ofs = readLE32(header + 42);
+    if(i.comp_size == 0xFFFFFFFF || readLE32(header + 24) == 0xFFFFFFFF || i.local_header_ofs == 0xFFFFFFFF){ // zip64
+      return false;
+    }
+
+    i.name.resize(name_len);
+    i.central_header.assign(header, 46);
+    i.central_header.resize(46 + extra_len + comment_len);
+    if(!(in.read(&i.name[0], name_len)) || !(in.read(&i.central_header[46], extra_len + comment_len))){
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Gets names of all entries in a zip file (including directories)
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *
+ * Returns:
+ *     names : Vector containing names of entries in the zip (in the order they are in the zip); empty if the zip could not be read
+ */
+std::vector<std::string> getZipEntryNames(std::string zip_path){
+  std::vector<zipEntry> entries;
+  std::vector<std::string> names;
+  if(readCentralDir(zip_path, entries)){
+    for(auto &i: entries){
+      names.push_back(i.name);
+    }
+  }
+  return names;
+}
+
+/*
+ * Copies bytes from one file to another
+ *
+ * Arguments:
+ *     in : File to copy from, positioned where copying should start
+ *     out : File to copy to
+ *     size : Number of bytes to copy
+ *
+ * Returns:
+ *     true if all bytes were copied, false if not
+ */
+bool copyBytes(std::ifstream &in, std::ofstream &out, unsigned long long size){
+  std::vector<char> buf(1024 * 64);
+  while(size > 0){
+    size_t n = std::min<unsigned long long>(size, buf.size());
+    if(!(in.read(buf.data(), n))){
+      return false;
+    }
+    out.write(buf.data(), n);
+    size -= n;
+  }
+  return out.good();
+}
+
+/*
+ * Copies an entry (local header and compressed data) from a zip to the zip being written, giving it a new name
+ *
+ * Arguments:
+ *     in : Zip to copy from
+ *     entry : Entry to copy; its name is set to the new name
+ *     out : Zip being written, positioned where the entry should go
+ *
+ * Returns:
+ *     true if the entry was copied, false if not
+ */
+bool copyEntry(std::ifstream &in, zipEntry &entry, std::ofstream &out){
+  char local_header[30];
+  in.clear();
+  in.seekg(entry.local_header_ofs);
+  if(!(in.read(local_header, 30)) || readLE32(local_header) != 0x04034b50){ // local file header signature
+    return false;
+  }
+  unsigned int old_name_len = readLE16(local_header + 26);
+  unsigned int extra_len = readLE16(local_header + 28);
+  std::string extra(extra_len, '\0');
+  in.seekg(old_name_len, std::ios::cur);
+  if(extra_len > 0 && !(in.read(&extra[0], extra_len))){
+    return false;
+  }
+
+  writeLE16(local_header + 6, entry.flags);
+  writeLE16(local_header + 26, entry.name.size());
+  out.write(local_header, 30);
+  out.write(entry.name.data(), entry.name.size());
+  out.write(extra.data(), extra_len);
+
+  unsigned long long data_size = entry.comp_size;
+  if(entry.flags & 0x8){ // sizes/CRC32 come after the data in a data descriptor, with or without its signature
+    char descriptor[4];
+    in.seekg(entry.comp_size, std::ios::cur);
+    if(!(in.read(descriptor, 4))){
+      return false;
+    }
+    in.seekg(-(long long)(entry.comp_size + 4), std::ios::cur);
+    data_size += readLE32(descriptor) == 0x08074b50 ? 16 : 12;
+  }
+  return copyBytes(in, out, data_size);
+}
+
+/*
+ * Callback for miniz's deflate compressor; writes compressed data to the zip being written
+ */
+mz_bool writeCompressed(const void *buf, int len, void *user){
+  std::ofstream *out = static_cast<std::ofstream *>(user);
+  out->write(static_cast<const char *>(buf), len);
+  return out->good();
+}
+
+/*
+ * Reads a file held in memory as a stream, without copying it
+ */
+struct memoryBuf : std::streambuf {
+  memoryBuf(const std::string &data){
+    char *p = const_cast<char *>(data.data());
+    setg(p, p, p + data.size());
+  }
+};
+
+/*
+ * Compresses a file (with deflate) into the zip being written
+ *
+ * Arguments:
+ *     in : File to compress, positioned at its start
+ *     file_size : Size of the file
+ *     mtime : Last modification time of the file
+ *     entry : Entry for the file; name has to be set, the rest is filled in
+ *     out : Zip being written, positioned where the entry should go
+ *     level : Compression level (0 to 9)
+ *
+ * Returns:
+ *     true if the file was added, false if not
+ */
+bool compressStream(std::istream &in, unsigned long long file_size, time_t mtime, zipEntry &entry, std::ofstream &out, int level){
+  if(file_size >= 0xFFFFFFFF){ // would need zip64
+    return false;
+  }
+
+  // DOS date and time of last modification
+  struct tm tm;
+  localtime_r(&mtime, &tm);
+  unsigned int dos_time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec >> 1);
+  unsigned int dos_date = ((tm.tm_year + 1900 - 1980) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+
+  entry.flags = 0;
+  for(auto c: entry.name){
+    if((unsigned char)c >= 0x80){ // name is not ASCII, so mark it as UTF-8
+      entry.flags |= 0x800;
+      break;
+    }
+  }
+
+  char local_header[30] = {0};
+  writeLE32(local_header, 0x04034b50);
+  writeLE16(local_header + 4, 20); // version needed to extract (2.0, deflate)
+  writeLE16(local_header + 6, entry.flags);
+  writeLE16(local_header + 8, 8); // deflate
+  writeLE16(local_header + 10, dos_time);
+  writeLE16(local_header + 12, dos_date);
+  writeLE16(local_header + 26, entry.name.size());
+  unsigned long long local_header_ofs = out.tellp();
+  out.write(local_header, 30);
+  out.write(entry.name.data(), entry.name.size());
+  unsigned long long data_start = out.tellp();
+
+  // compressing
+  std::unique_ptr<tdefl_compressor> compressor(new tdefl_compressor); // too big for the stack
+  tdefl_init(compressor.get(), writeCompressed, &out, tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY)); // -15: raw deflate (no zlib header)
+  std::vector<char> buf(1024 * 64);
+  unsigned long crc32 = 0;
+  unsigned long long size = 0;
+  while(in.read(buf.data(), buf.size()) || in.gcount() > 0){
+    size_t n = in.gcount();
+    crc32 = mz_crc32(crc32, reinterpret_cast<const unsigned char *>(buf.data()), n);
+    size += n;
+    if(tdefl_compress_buffer(compressor.get(), buf.data(), n, TDEFL_NO_FLUSH) != TDEFL_STATUS_OKAY){
+      return false;
+    }
+  }
+  if(tdefl_compress_buffer(compressor.get(), nullptr, 0, TDEFL_FINISH) != TDEFL_STATUS_DONE || size != file_size){
+    return false;
+  }
+  unsigned long long comp_size = (unsigned long long)out.tellp() - data_start;
+  if(comp_size >= 0xFFFFFFFF){
+    return false;
+  }
+
+  // filling in CRC32 and sizes in local header
+  writeLE32(local_header + 14, crc32);
+  writeLE32(local_header + 18, comp_size);
+  writeLE32(local_header + 22, size);
+  out.seekp(local_header_ofs);
+  out.write(local_header, 30);
+  out.seekp(0, std::ios::end);
+
+  entry.comp_size = comp_size;
+  entry.central_header.assign(46, '\0');
+  char *central_header = &entry.central_header[0];
+  writeLE32(central_header, 0x02014b50);
+  writeLE16(central_header + 4, 0x0314); // version made by (Unix, 2.0)
+  memcpy(central_header + 6, local_header + 4, 26); // version needed to extract through extra field length are the same as in local header
+  writeLE32(central_header + 38, 0100644 << 16); // external attributes: regular file with permissions 0644
+  return out.good();
+}
+
+/*
+ * Compresses a file on disk (with deflate) into the zip being written; see compressStream()
+ */
+bool compressEntry(std::string path, zipEntry &entry, std::ofstream &out, int level){
+  std::ifstream in(path, std::ios::binary);
+  struct stat st;
+  if(!(in) || stat(path.c_str(), &st) != 0){
+    return false;
+  }
+  return compressStream(in, st.st_size, st.st_mtime, entry, out, level);
+}
+
+/*
+ * Writes entries to a zip being written; see writeZip()
+ *
+ * Arguments:
+ *     out : Zip being written, positioned where the first entry should go
+ *     members : As in writeZip()
+ *     compression_level : As in writeZip()
+ *     entries : Vector that the entries written are added to
+ *     local_header_ofs : Vector that the offsets of the entries written are added to
+ *
+ * Returns:
+ *     true if all entries were written, false if not
+ */
+bool writeMembers(std::ofstream &out, const std::vector<std::tuple<std::string, std::string, std::string>> &members, const workspace *ws, std::string compression_level, std::vector<zipEntry> &entries, std::vector<unsigned long long> &local_header_ofs){
+  std::map<std::string, std::vector<zipEntry>> sources; // key is path to source zip, value is its entries
+  std::map<std::string, std::map<std::string, int>> source_index; // key is path to source zip, value is map with key as name of entry and value as index of entry
+  for(auto i: members){
+    std::string source = std::get<0>(i);
+    if(std::get<1>(i).empty() || source.empty() || sources.count(source)){
+      continue;
+    }
+    if(!(readCentralDir(source, sources[source]))){
+      return false;
+    }
+    for(int j = 0; j < sources[source].size(); j++){
+      source_index[source][sources[source][j].name] = j;
+    }
+  }
+
+  std::map<std::string, std::ifstream> in; // key is path to source zip
+  for(auto i: members){
+    std::string source = std::get<0>(i);
+    zipEntry entry;
+    unsigned long long ofs = out.tellp();
+    if(ofs >= 0xFFFFFFFF){ // would need zip64
+      return false;
+    }
+
+    bool ok;
+    if(std::get<1>(i).empty()){ // file on disk
+      entry.name = std::get<2>(i);
+      ok = compressEntry(source, entry, out, std::stoi(compression_level));
+    } else if (source.empty()){ // file in workspace
+      auto it = ws->entries.find(std::get<1>(i));
+      if(it == ws->entries.end()){
+        return false;
+      }
+      entry.name = std::get<2>(i);
+      if(it->second.path.empty()){ // held in memory
+        memoryBuf buf(it->second.data);
+        std::istream in_memory(&buf);
+        ok = compressStream(in_memory, it->second.size, it->second.mtime, entry, out, std::stoi(compression_level));
+      } else {
+        ok = compressEntry(it->second.path, entry, out, std::stoi(compression_level));
+      }
+    } else {
+      auto it = source_index[source].find(std::get<1>(i));
+      if(it == source_index[source].end()){ // not in source zip
+        return false;
+      }
+      if(!(in.count(source))){
+        in[source].open(source, std::ios::binary);
+      }
+      entry = sources[source][it->second];
+      entry.name = std::get<2>(i);
+      for(auto c: entry.name){
+        if((unsigned char)c >= 0x80){ // name is not ASCII, so mark it as UTF-8
+          entry.flags |= 0x800;
+          break;
+        }
+      }
+      ok = copyEntry(in[source], entry, out);
+    }
+    if(!(ok)){
+      return false;
+    }
+    entries.push_back(entry);
+    local_header_ofs.push_back(ofs);
+  }
+  return true;
+}
+
+/*
+ * Writes the central directory and end of central directory record of a zip being written (without a zip comment)
+ *
+ * Arguments:
+ *     out : Zip being written, positioned after the last entry
+ *     entries : Entries in the zip (in order)
+ *     local_header_ofs : Offsets of the entries in the zip
+ *
+ * Returns:
+ *     true if it was written, false if not (e.g. zip64 is needed)
+ */
+bool writeCentralDir(std::ofstream &out, std::vector<zipEntry> &entries, const std::vector<unsigned long long> &local_header_ofs){
+  unsigned long long central_dir_start = out.tellp();
+  for(int i = 0; i < entries.size(); i++){
+    std::string &central_header = entries[i].central_header;
+    writeLE16(&central_header[8], entries[i].flags);
+    writeLE16(&central_header[28], entries[i].name.size());
+    writeLE32(&central_header[42], local_header_ofs[i]);
+    out.write(central_header.data(), 46);
+    out.write(entries[i].name.data(), entries[i].name.size());
+    out.write(central_header.data() + 46, central_header.size() - 46);
+  }
+  unsigned long long central_dir_end = out.tellp();
+
+  char end_of_central_dir[22] = {0};
+  writeLE32(end_of_central_dir, 0x06054b50); // end of central directory signature
+  writeLE16(end_of_central_dir + 8, entries.size());
+  writeLE16(end_of_central_dir + 10, entries.size());
+  writeLE32(end_of_central_dir + 12, central_dir_end - central_dir_start);
+  writeLE32(end_of_central_dir + 16, central_dir_start);
+  out.write(end_of_central_dir, 22);
+  return central_dir_end < 0xFFFFFFFF && out.good();
+}
+
+/*
+ * Writes a zip file; see repackZip()
+ *
+ * Arguments:
+ *     destination : Path to zip file to be written
+ *     members : As in repackZip(); in addition, source can be "" for a file in ws (name in source is its name in ws)
+ *     ws : Workspace that files come from, or nullptr if there is none
+ *     compression_level : Compression level to use for files on disk and in ws
+ *
+ * Returns:
+ *     true if the zip was written, false if not (destination is left unchanged)
+ */
+bool writeZip(std::string destination, const std::vector<std::tuple<std::string, std::string, std::string>> &members, const workspace *ws, std::string compression_level){
+  std::set<std::string> names;
+  for(auto i: members){
+    if(!(names.insert(std::get<2>(i)).second) || std::get<2>(i).size() > 0xFFFF){ // name duplicated or too long
+      return false;
+    }
+  }
+  if(members.size() >= 0xFFFF){ // would need zip64
+    return false;
+  }
+
+  std::string tmp_zip_path = destination + ".tmp";
+  std::ofstream out(tmp_zip_path, std::ios::binary);
+  std::vector<zipEntry> entries;
+  std::vector<unsigned long long> local_header_ofs;
+  bool ok = writeMembers(out, members, ws, compression_level, entries, local_header_ofs) && writeCentralDir(out, entries, local_header_ofs);
+
+  out.close();
+  if(!(ok)){
+    filesys::remove(tmp_zip_path);
+    return false;
+  }
+  filesys::rename(tmp_zip_path, destination);
+  return true;
+}
+
+/*
+ * Adds entries to the end of a zip file in place: only the new entries and a new central directory are written, so the time taken depends on what is added, not on the size of the zip
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *     members : All entries the zip should have once written, as in repackZip() (in order). The zip's entries have to come first, unchanged (source zip_path, same name) and in the order they are in the zip
+ *     compression_level (Optional) : Compression level to use for files on disk; "0" or "1" or "2" etc to "9"
+ *     sorted (Optional) : true to keep entries in order of name; members are sorted by name first, so entries can only be added if the zip's entries are in order of name and the new ones sort after them
+ *
+ * Returns:
+ *     true if the entries were added, false if not (members do not start with the zip's entries, or the zip could not be edited); zip is left unchanged, so the caller should repack it instead (with members sorted by name, if sorted is true)
+ *
+ * Notes:
+ *     The new entries and central directory are written after the old end of central directory record, which is left as it is, so the zip stays readable until the new end of central directory record (written last) is there. If writing fails, the zip is cut back to its old size
+ *     The old central directory is left in the zip as unused bytes, until the zip is next repacked
+ *     The zip comment is dropped (e.g. a TorrentZip comment would no longer be valid)
+ */
+bool appendZip(std::string zip_path, std::vector<std::tuple<std::string, std::string, std::string>> members, std::string compression_level, bool sorted){
+  if(sorted){
+    std::stable_sort(members.begin(), members.end(), [](const std::tuple<std::string, std::string, std::string> &a, const std::tuple<std::string, std::string, std::string> &b){ return std::get<2>(a) < std::get<2>(b); });
+  }
+  std::vector<zipEntry> entries;
+  if(!(readCentralDir(zip_path, entries)) || members.size() < entries.size() || members.size() >= 0xFFFF){
+    return false;
+  }
+  std::set<std::string> names;
+  for(int i = 0; i < members.size(); i++){
+    if(i < entries.size() && (std::get<0>(members[i]) != zip_path || std::get<1>(members[i]) != entries[i].name || std::get<2>(members[i]) != entries[i].name)){ // zip's entries are not all kept as they are
+      return false;
+    }
+    if(!(names.insert(std::get<2>(members[i])).second) || std::get<2>(members[i]).size() > 0xFFFF){ // name duplicated or too long
+      return false;
+    }
+  }
+  if(members.size() == entries.size()){ // nothing to add
+    return true;
+  }
+
+  unsigned long long zip_size = filesys::file_size(zip_path);
+  std::ofstream out(zip_path, std::ios::in | std::ios::out | std::ios::binary); // in: file is not truncated
+  out.seekp(zip_size); // after the old end of central directory record, so the zip is not changed until the new one is written
+  std::vector<unsigned long long> local_header_ofs;
+  for(auto &i: entries){
+    local_header_ofs.push_back(i.local_header_ofs);
+  }
+  std::vector<std::tuple<std::string, std::string, std::string>> new_members(members.begin() + entries.size(), members.end());
+  bool ok = writeMembers(out, new_members, nullptr, compression_level, entries, local_header_ofs) && writeCentralDir(out, entries, local_header_ofs);
+  out.close();
+  ok = ok && !(out.fail()); // what was buffered is only written out on close
+
+  if(!(ok)){ // drop what was written
+    filesys::resize_file(zip_path, zip_size);
+  }
+  return ok;
+}
+
+/*
+ * Writes a zip file from entries of other zips and files on disk. Entries from zips are copied without being decompressed (compressed data, CRC32 and sizes are copied as is), files on disk are compressed with deflate.
+ *
+ * Arguments:
+ *     destination : Path to zip file to be written; can also be one of the zips that entries are copied from
+ *     members : Vector of tuples containing source, name in source and name in destination of every entry to be written (in order). Source is a path to a zip file, or a path to a file on disk if name in source is ""
+ *     compression_level (Optional) : Compression level to use for files on disk; "0" or "1" or "2" etc to "9"
+ *
+ * Returns:
+ *     true if the zip was written, false if not (destination is left unchanged, so the caller should extract and rezip instead)
+ *
+ * Notes:
+ *     The zip is written to a temporary file first, which then replaces destination
+ *     Zip64 zips (entries or zips 4GiB and over, 65535 entries and over), entries that are not in their source zip and entries with the same name in destination are not handled
+ */
+bool repackZip(std::string destination, std::vector<std::tuple<std::string, std::string, std::string>> members, std::string compression_level){
+  return writeZip(destination, members, nullptr, compression_level);
+}
+
+/*
+ * Renames entries in a zip file without decompressing them
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *     renames : Map with key as current name of entry, value as new name of entry
+ *
+ * Returns:
+ *     true if the entries were renamed, false if the zip could not be edited (zip is left unchanged, so the caller should extract and rezip it instead)
+ *
+ * Notes:
+ *     Only the local headers and central directory change, see repackZip()
+ *     The zip comment is dropped (e.g. a TorrentZip comment would no longer be valid after renaming)
+ */
+bool renameInZip(std::string zip_path, const std::map<std::string, std::string> &renames){
+  std::vector<zipEntry> entries;
+  if(!(readCentralDir(zip_path, entries))){
+    return false;
+  }
+
+  std::vector<std::tuple<std::string, std::string, std::string>> members;
+  int no_of_renames = 0;
+  for(auto &i: entries){
+    auto it = renames.find(i.name);
+    if(it != renames.end()){
+      members.push_back(std::make_tuple(zip_path, i.name, it->second));
+      no_of_renames += 1;
+    } else {
+      members.push_back(std::make_tuple(zip_path, i.name, i.name));
+    }
+  }
+  if(no_of_renames != renames.size()){ // some entries to be renamed are not in zip
+    return false;
+  }
+
+  return repackZip(zip_path, members);
+}
+
+/*
+ * Adds files on disk to a zip file, without decompressing and recompressing what is already in the zip. The zip is created if it does not exist.
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *     filenames : Vector containing strings of file paths
+ *     rootfolder : Root folder of file paths (*path must end with a forward slash); names in zip are file paths relative to it
+ *     compression_level : Compression level to use for the files; "0" or "1" or "2" etc to "9"
+ *     sorted (Optional) : true to keep entries in order of name; if the files can't be appended in order (see appendZip()), the zip is repacked with its entries sorted
+ *
+ * Returns:
+ *     true if the files were added, false if the zip could not be edited (zip is left unchanged, so the caller should extract and rezip it instead)
+ *
+ * Notes:
+ *     If a file has the same name as an entry already in the zip, the entry in the zip is kept (the same as extracting the zip over the files, then zipping them)
+ *     The files are appended to the zip in place if they can be (see appendZip()); if not, the zip is repacked
+ */
+bool addToZip(std::string zip_path, std::vector<std::string> filenames, std::string rootfolder, std::string compression_level, bool sorted){
+  std::vector<std::tuple<std::string, std::string, std::string>> members;
+  std::set<std::string> in_zip;
+  if(filesys::exists(zip_path)){
+    std::vector<zipEntry> entries;
+    if(!(readCentralDir(zip_path, entries))){
+      return false;
+    }
+    for(auto &i: entries){
+      members.push_back(std::make_tuple(zip_path, i.name, i.name));
+      in_zip.insert(i.name);
+    }
+  }
+
+  for(auto i: filenames){
+    std::string filename = i.substr(rootfolder.length()); // make filenames in zip a relative path
+    if(!(in_zip.count(filename))){
+      members.push_back(std::make_tuple(i, "", filename));
+    }
+  }
+
+  if(!(in_zip.empty()) && appendZip(zip_path, members, compression_level, sorted)){
+    return true;
+  }
+  if(sorted){
+    std::stable_sort(members.begin(), members.end(), [](const std::tuple<std::string, std::string, std::string> &a, const std::tuple<std::string, std::string, std::string> &b){ return std::get<2>(a) < std::get<2>(b); });
+  }
+  return repackZip(zip_path, members, compression_level);
+}
+
+/*
+ * Writes all files in a workspace to a zip file (compressed with deflate, in order of name)
+ *
+ * Arguments:
+ *     zip_path : Path to zip file to be written (replaced if it exists)
+ *     ws : Workspace (see definition in workspace.h)
+ *     compression_level (Optional) : Compression level to use; "0" or "1" or "2" etc to "9"
+ *
+ * Returns:
+ *     true if the zip was written, false if not (zip64 is needed; zip_path is left unchanged, so the caller should write the workspace to disk and zip it with write_zip() instead)
+ */
+bool writeWorkspaceZip(std::string zip_path, const workspace &ws, std::string compression_level){
+  std::vector<std::tuple<std::string, std::string, std::string>> members;
+  for(auto &i: ws.entries){
+    members.push_back(std::make_tuple("", i.first, i.first));
+  }
+  return writeZip(zip_path, members, &ws, compression_level);
+}
+
+/*
+ * Gets CRC32 of the central directory of a zip file (from its start to the end of the file, so the end of central directory record and zip comment are included)
+ *
+ * Arguments:
+ *     zip_path : Path to zip file
+ *
+ * Returns:
+ *     crc32 : CRC32 as a hex string (uppercase), or "-" if the zip could not be read
+ *
+ * Notes:
+ *     Every entry's name, CRC32, sizes and offset are in the central directory, so this changes whenever what is in the zip changes; the compressed data is not read
+ */
+std::string getCentralDirCRC32(std::string zip_path){
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if(!(mz_zip_reader_init_file(&zip, zip_path.c_str(), 0))){
+    return "-";
+  }
+  unsigned long long central_dir_ofs = zip.m_central_directory_file_ofs;
+  mz_zip_reader_end(&zip);
+
+  std::ifstream in(zip_path, std::ios::binary);
+  in.seekg(central_dir_ofs);
+  std::vector<char> buf(1024 * 64);
+  unsigned long crc32 = MZ_CRC32_INIT;
+  while(in.read(buf.data(), buf.size()) || in.gcount() > 0){
+    crc32 = mz_crc32(crc32, reinterpret_cast<const unsigned char *>(buf.data()), in.gcount());
+  }
+
+  char hex[9];
+  snprintf(hex, sizeof(hex), "%08lX", crc32);
+  return hex;
+}